@@ -0,0 +1,153 @@
+//
+// Background page reads: one worker thread, a queue of submitted reads and a queue of finished ones.
+//
+// The worker never holds the queue lock while it reads, so submitting and collecting never wait for the disk. The
+// event pipe holds one byte while the finished queue is non-empty: the worker writes it when the queue goes from empty
+// to non-empty, and asyncCollect drains it when it empties the queue, both under the queue lock.
+//
+#include "async_read.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+struct AsyncReader {
+    pthread_t thread;
+    pthread_mutex_t lock;       // guards the queues and stop
+    pthread_cond_t submitted;   // the worker waits on it for work
+    pthread_cond_t finished;    // asyncCollect waits on it for a finished read
+    pthread_mutex_t ioLatch;    // held around every storage manager call on the pool's file handles
+
+    AsyncRead *queueHead, *queueTail;  // submitted, not started
+    AsyncRead *doneHead, *doneTail;    // finished, not collected
+    bool stop;
+    int events[2];              // the event pipe: read end, write end
+};
+
+static long long nowNanos(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static void *readerMain(void *arg) {
+    AsyncReader *r = arg;
+
+    pthread_mutex_lock(&r->lock);
+    while (1) {
+        while (!r->queueHead && !r->stop)
+            pthread_cond_wait(&r->submitted, &r->lock);
+        if (!r->queueHead)
+            break; // stopped, and every submitted read is done
+        AsyncRead *read = r->queueHead;
+        r->queueHead = read->next;
+        if (!r->queueHead)
+            r->queueTail = NULL;
+        pthread_mutex_unlock(&r->lock);
+
+        long long start = nowNanos();
+        pthread_mutex_lock(&r->ioLatch);
+        read->rc = readBlock(read->pageNum, read->fh, read->data);
+        pthread_mutex_unlock(&r->ioLatch);
+        read->nanos = nowNanos() - start;
+
+        pthread_mutex_lock(&r->lock);
+        read->next = NULL;
+        if (r->doneTail)
+            r->doneTail->next = read;
+        else {
+            r->doneHead = read;
+            if (write(r->events[1], "", 1) != 1) {
+                // the pipe is never full (it holds at most this byte), so this doesn't happen
+            }
+        }
+        r->doneTail = read;
+        pthread_cond_broadcast(&r->finished);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return NULL;
+}
+
+AsyncReader *startAsyncReader(void) {
+    AsyncReader *r = malloc(sizeof(AsyncReader));
+
+    if (!r)
+        return NULL;
+    if (pipe(r->events) != 0) {
+        free(r);
+        return NULL;
+    }
+    fcntl(r->events[0], F_SETFL, fcntl(r->events[0], F_GETFL) | O_NONBLOCK);
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_mutex_init(&r->ioLatch, NULL);
+    pthread_cond_init(&r->submitted, NULL);
+    pthread_cond_init(&r->finished, NULL);
+    r->queueHead = r->queueTail = NULL;
+    r->doneHead = r->doneTail = NULL;
+    r->stop = FALSE;
+    if (pthread_create(&r->thread, NULL, readerMain, r) != 0) {
+        r->stop = TRUE; // no thread to join
+        stopAsyncReader(r);
+        return NULL;
+    }
+    return r;
+}
+
+void stopAsyncReader(AsyncReader *r) {
+    if (!r)
+        return;
+    if (!r->stop) {
+        pthread_mutex_lock(&r->lock);
+        r->stop = TRUE;
+        pthread_cond_signal(&r->submitted);
+        pthread_mutex_unlock(&r->lock);
+        pthread_join(r->thread, NULL);
+    }
+    pthread_mutex_destroy(&r->lock);
+    pthread_mutex_destroy(&r->ioLatch);
+    pthread_cond_destroy(&r->submitted);
+    pthread_cond_destroy(&r->finished);
+    close(r->events[0]);
+    close(r->events[1]);
+    free(r);
+}
+
+void asyncSubmit(AsyncReader *r, AsyncRead *read) {
+    read->next = NULL;
+    pthread_mutex_lock(&r->lock);
+    if (r->queueTail)
+        r->queueTail->next = read;
+    else
+        r->queueHead = read;
+    r->queueTail = read;
+    pthread_cond_signal(&r->submitted);
+    pthread_mutex_unlock(&r->lock);
+}
+
+AsyncRead *asyncCollect(AsyncReader *r, const bool wait) {
+    char buf[16];
+
+    pthread_mutex_lock(&r->lock);
+    while (wait && !r->doneHead)
+        pthread_cond_wait(&r->finished, &r->lock);
+    AsyncRead *done = r->doneHead;
+    r->doneHead = r->doneTail = NULL;
+    if (done)
+        while (read(r->events[0], buf, sizeof(buf)) > 0)
+            ;
+    pthread_mutex_unlock(&r->lock);
+    return done;
+}
+
+int asyncEventFd(AsyncReader *r) {
+    return r->events[0];
+}
+
+void asyncLockIO(AsyncReader *r) {
+    pthread_mutex_lock(&r->ioLatch);
+}
+
+void asyncUnlockIO(AsyncReader *r) {
+    pthread_mutex_unlock(&r->ioLatch);
+}
@@ -0,0 +1,42 @@
+#ifndef ASYNC_READ_H
+#define ASYNC_READ_H
+
+#include "buffer_mgr.h"
+#include "storage_mgr.h"
+
+// Background page reads
+// A worker thread reads pages for a buffer pool, so a miss doesn't block the thread that asked for it. Reads are done
+// one at a time in the order they were submitted. Finished reads wait until the pool collects them on its own thread;
+// a pipe is readable while any are waiting, so an event loop can poll for them along with its sockets.
+// The storage manager's file handles aren't safe to use from two threads at once, so the worker holds the reader's
+// I/O latch around every read, and the pool has to hold it around its own storage calls while a reader exists.
+
+typedef struct AsyncReader AsyncReader;
+
+// a read handed to the worker; the submitter owns the memory and embeds it in its own bookkeeping
+typedef struct AsyncRead {
+	SM_FileHandle *fh;          // has to stay valid until the read is collected
+	PageNumber pageNum;
+	char *data;                 // a buffer of fh->pageSize bytes
+	RC rc;                      // set by the worker: readBlock's result
+	long long nanos;            // set by the worker: how long the read took
+	struct AsyncRead *next;
+} AsyncRead;
+
+// starts the worker thread; NULL if it can't be started
+AsyncReader *startAsyncReader (void);
+// stops the worker once it is done with the reads submitted so far, and frees the reader. Reads that weren't
+// collected are dropped without notice, so collect them first.
+void stopAsyncReader (AsyncReader *reader);
+
+void asyncSubmit (AsyncReader *reader, AsyncRead *read);
+// takes the finished reads, oldest first, as a list linked through next; NULL if there are none. With wait, blocks
+// until there is one, so only wait while something is submitted and not yet collected.
+AsyncRead *asyncCollect (AsyncReader *reader, const bool wait);
+// readable while finished reads wait to be collected
+int asyncEventFd (AsyncReader *reader);
+
+void asyncLockIO (AsyncReader *reader);
+void asyncUnlockIO (AsyncReader *reader);
+
+#endif
@@ -0,0 +1,536 @@
+//
+// Workload-driven benchmark for the buffer manager's replacement strategies.
+//
+// Every workload produces one reference string (page numbers plus whether the access writes the page), which is then
+// replayed against every pool size and every replacement strategy, so all strategies see exactly the same accesses.
+// Next to the built-in strategies runs MRU, a sample RS_CUSTOM strategy defined here. On the index workload every
+// built-in strategy runs a second time (as hLRU etc.) pinning with the workload's page hints, see pinPageWithHint.
+//
+// usage: bench_buffer_mgr [-w workload] [-n filePages] [-o ops] [-p poolSizes] [-s skew] [-r writeRatio]
+//                         [-l loopPages] [-k K] [-c window] [-t tierKB] [-x seed]
+//        bench_buffer_mgr -L maxFrames [-o ops] [-x seed]
+//   -w  uniform | zipf | seq | loop | hotscan | index | all  (default all)
+//   -n  pages in the page file                        (default 10000)
+//   -o  accesses per run                              (default 50000)
+//   -p  comma separated pool sizes                    (default 100,1000,5000)
+//   -s  zipf skew                                     (default 0.99)
+//   -r  fraction of accesses that mark the page dirty (default 0.2)
+//   -l  pages the looping scan cycles through         (default filePages / 4)
+//   -k  K for LRU_K                                   (default 2)
+//   -c  clean-first window, 0 for off                 (default 0)
+//   -t  compressed victim tier in KB, 0 for off       (default 0)
+//   -x  random seed                                   (default 42)
+//   -L  instead of the workloads, time pin hits through the page table and through the frame scan for pool sizes
+//       from 8 up to maxFrames, to find the crossover (BM_SCAN_FRAMES in buffer_mgr.c)
+//
+#include "buffer_mgr.h"
+#include "buffer_mgr_trace.h"
+#include "storage_mgr.h"
+#include "dberror.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_FILE "bench_buffer_mgr.bin"
+#define MAX_POOL_SIZES 16
+
+typedef enum Workload {
+    WL_UNIFORM,
+    WL_ZIPF,
+    WL_SEQ,
+    WL_LOOP,
+    WL_HOTSCAN,
+    WL_INDEX,
+    WL_COUNT
+} Workload;
+
+static const char *workloadNames[] = {"uniform", "zipf", "seq", "loop", "hotscan", "index"};
+static const char *hintedNames[] = {"hFIFO", "hLRU", "hCLOCK", "hLFU", "hLRU-K"};
+
+// the index workload: a B-tree root (page 0) and INDEX_INNER_PAGES inner pages in front of the heap pages
+#define INDEX_INNER_PAGES 16
+
+static const ReplacementStrategy strategies[] = {RS_FIFO, RS_LRU, RS_CLOCK, RS_LFU, RS_LRU_K, RS_CUSTOM};
+static const char *strategyNames[] = {"FIFO", "LRU", "CLOCK", "LFU", "LRU-K", "MRU"};
+#define NUM_STRATEGIES ((int) (sizeof(strategies) / sizeof(strategies[0])))
+
+typedef struct BenchConfig {
+    int workload;       // -1 for all of them
+    int filePages;
+    int ops;
+    int poolSizes[MAX_POOL_SIZES];
+    int numPoolSizes;
+    double skew;
+    double writeRatio;
+    int loopPages;
+    int k;
+    int cleanFirst;
+    long tierKB;
+    int lookupFrames;   // 0 unless -L
+    unsigned long long seed;
+} BenchConfig;
+
+// one access of a reference string
+typedef struct Access {
+    PageNumber pageNum;
+    bool write;
+    BM_PageHint hint;  // what a client that knows the page would pin it with
+} Access;
+
+typedef struct RunResult {
+    int reads;
+    int writes;
+    long long dirtyEvictions; // writes pins had to wait for
+    double seconds;
+    double p50, p90, p99, max; // pin latency, microseconds
+    int indexPins;   // pins of pages hinted BM_HINT_RESIDENT (the index workload's root and inner pages)
+    int indexMisses;
+} RunResult;
+
+/*
+ * MRU, as an RS_CUSTOM strategy: ejects the unpinned page that was used last. That's the page a looping scan larger
+ * than the pool needs furthest in the future, where LRU ejects the one it needs next.
+ *  A linear search per miss is fine for a sample; a real strategy would keep a heap.
+ */
+typedef struct MruState {
+    long long clock;
+    long long *lastUse;  // per frame, -1 if the frame is free
+} MruState;
+
+static void mruHit(void *state, int frame) {
+    MruState *s = state;
+    s->lastUse[frame] = ++s->clock;
+}
+
+static void mruLoad(void *state, int frame, int fileId, PageNumber pageNum) {
+    (void) fileId;
+    (void) pageNum;
+    mruHit(state, frame);
+}
+
+static void mruEvict(void *state, int frame) {
+    MruState *s = state;
+    s->lastUse[frame] = -1;
+}
+
+static void mruMove(void *state, int from, int to) {
+    MruState *s = state;
+    s->lastUse[to] = s->lastUse[from];
+    s->lastUse[from] = -1;
+}
+
+static int mruVictim(void *state, const int *fixCounts, int numFrames) {
+    MruState *s = state;
+    int victim = -1;
+
+    for (int i = 0; i < numFrames; i++)
+        if (s->lastUse[i] >= 0 && fixCounts[i] == 0 && (victim < 0 || s->lastUse[i] > s->lastUse[victim]))
+            victim = i;
+    return victim;
+}
+
+/*
+ * xorshift64*; the benchmark has to be reproducible, so it doesn't use rand()
+ */
+static unsigned long long rngState;
+
+static unsigned long long nextRandom(void) {
+    rngState ^= rngState >> 12;
+    rngState ^= rngState << 25;
+    rngState ^= rngState >> 27;
+    return rngState * 2685821657736338717ULL;
+}
+
+static double nextUniform(void) {
+    return (nextRandom() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/*
+ * the cumulative distribution of a zipf distribution over n pages, page 0 being the most popular
+ */
+static double *zipfCdf(int n, double skew) {
+    double *cdf = malloc(sizeof(double) * n);
+    double sum = 0;
+
+    for (int i = 0; i < n; i++)
+        sum += 1.0 / pow(i + 1, skew);
+    double acc = 0;
+    for (int i = 0; i < n; i++) {
+        acc += 1.0 / pow(i + 1, skew) / sum;
+        cdf[i] = acc;
+    }
+    cdf[n - 1] = 1.0;
+    return cdf;
+}
+
+static int sampleCdf(const double *cdf, int n) {
+    double u = nextUniform();
+    int lo = 0, hi = n - 1;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (cdf[mid] < u)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * builds the reference string of a workload
+ *  zipf scatters its popular pages over the file, so popularity doesn't line up with page order
+ */
+static Access *makeWorkload(const BenchConfig *cfg, Workload w) {
+    Access *refs = malloc(sizeof(Access) * cfg->ops);
+    int n = cfg->filePages;
+    double *cdf = NULL;
+    PageNumber *scatter = NULL;
+    int hotPages = n / 10 > 0 ? n / 10 : 1;
+    int scanPos = 0;
+    int heapPages = n - 1 - INDEX_INNER_PAGES > 0 ? n - 1 - INDEX_INNER_PAGES : 1;
+
+    rngState = cfg->seed * 2654435761ULL + w + 1;
+    if (w == WL_ZIPF) {
+        cdf = zipfCdf(n, cfg->skew);
+        scatter = malloc(sizeof(PageNumber) * n);
+        for (int i = 0; i < n; i++)
+            scatter[i] = i;
+        for (int i = n - 1; i > 0; i--) {
+            int j = (int) (nextRandom() % (i + 1));
+            PageNumber t = scatter[i];
+            scatter[i] = scatter[j];
+            scatter[j] = t;
+        }
+    }
+
+    for (int i = 0; i < cfg->ops; i++) {
+        refs[i].hint = BM_HINT_NORMAL;
+        switch (w) {
+            case WL_UNIFORM:
+                refs[i].pageNum = (PageNumber) (nextRandom() % n);
+                break;
+            case WL_ZIPF:
+                refs[i].pageNum = scatter[sampleCdf(cdf, n)];
+                break;
+            case WL_SEQ:
+                refs[i].pageNum = i % n;
+                break;
+            case WL_LOOP:
+                refs[i].pageNum = i % cfg->loopPages;
+                break;
+            case WL_HOTSCAN:
+                // 80% of the accesses go to a hot set of 10% of the file, the rest is a scan over the other pages
+                if (nextUniform() < 0.8)
+                    refs[i].pageNum = (PageNumber) (nextRandom() % hotPages);
+                else {
+                    refs[i].pageNum = hotPages + scanPos;
+                    scanPos = (scanPos + 1) % (n - hotPages > 0 ? n - hotPages : 1);
+                }
+                break;
+            case WL_INDEX:
+                // index lookups (root, an inner page, a random heap page) under a heap scan that reads three pages
+                // for every lookup: the scan churns the pool, so the inner pages fall out unless they are hinted
+                switch (i % 6) {
+                    case 0:
+                        refs[i].pageNum = 0;
+                        refs[i].hint = BM_HINT_RESIDENT;
+                        break;
+                    case 1:
+                        refs[i].pageNum = 1 + (PageNumber) (nextRandom() % INDEX_INNER_PAGES);
+                        refs[i].hint = BM_HINT_RESIDENT;
+                        break;
+                    case 2:
+                        refs[i].pageNum = 1 + INDEX_INNER_PAGES + (PageNumber) (nextRandom() % heapPages);
+                        break;
+                    default:
+                        refs[i].pageNum = 1 + INDEX_INNER_PAGES + scanPos;
+                        refs[i].hint = BM_HINT_COLD;
+                        scanPos = (scanPos + 1) % heapPages;
+                        break;
+                }
+                break;
+            default:
+                break;
+        }
+        refs[i].write = nextUniform() < cfg->writeRatio;
+    }
+
+    free(cdf);
+    free(scatter);
+    return refs;
+}
+
+static double elapsedNanos(const struct timespec *a, const struct timespec *b) {
+    return (b->tv_sec - a->tv_sec) * 1e9 + (b->tv_nsec - a->tv_nsec);
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * replays the reference string against a fresh pool
+ */
+static RC runOne(const BenchConfig *cfg, const Access *refs, ReplacementStrategy strategy, bool hinted,
+                 int poolSize, double *latencies, RunResult *result) {
+    BM_BufferPool bm;
+    BM_PageHandle h;
+    BM_PoolStatistics stats;
+    struct timespec start, end, t0, t1;
+    MruState mru = {0, NULL};
+    BM_CustomStrategy custom = {.state = &mru, .onLoad = mruLoad, .onHit = mruHit, .chooseVictim = mruVictim,
+                                .onEvict = mruEvict, .onMove = mruMove};
+    void *stratData = (void *) (long) cfg->k;
+    RC rc;
+
+    if (strategy == RS_CUSTOM) {
+        mru.lastUse = malloc(sizeof(long long) * poolSize);
+        for (int i = 0; i < poolSize; i++)
+            mru.lastUse[i] = -1;
+        stratData = &custom;
+    }
+    rc = initBufferPool(&bm, BENCH_FILE, poolSize, strategy, stratData);
+    if (rc != RC_OK) {
+        free(mru.lastUse);
+        return rc;
+    }
+    setCleanFirstWindow(&bm, cfg->cleanFirst);
+    setCompressedTier(&bm, cfg->tierKB * 1024);
+
+    result->indexPins = result->indexMisses = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < cfg->ops; i++) {
+        int reads = getNumReadIO(&bm);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        if (hinted)
+            rc = pinPageWithHint(&bm, &h, refs[i].pageNum, refs[i].hint);
+        else
+            rc = pinPage(&bm, &h, refs[i].pageNum);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        if (refs[i].hint == BM_HINT_RESIDENT) {
+            result->indexPins++;
+            result->indexMisses += getNumReadIO(&bm) > reads;
+        }
+        if (rc != RC_OK) {
+            shutdownBufferPool(&bm);
+            free(mru.lastUse);
+            return rc;
+        }
+        latencies[i] = elapsedNanos(&t0, &t1) / 1000.0;
+        if (refs[i].write) {
+            h.data[0]++;
+            markDirty(&bm, &h);
+        }
+        unpinPage(&bm, &h);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    result->reads = getNumReadIO(&bm);
+    result->writes = getNumWriteIO(&bm);
+    result->seconds = elapsedNanos(&start, &end) / 1e9;
+    getPoolStatistics(&bm, &stats);
+    result->dirtyEvictions = stats.dirtyEvictions;
+
+    qsort(latencies, cfg->ops, sizeof(double), compareDouble);
+    result->p50 = latencies[(int) (cfg->ops * 0.50)];
+    result->p90 = latencies[(int) (cfg->ops * 0.90)];
+    result->p99 = latencies[(int) (cfg->ops * 0.99)];
+    result->max = latencies[cfg->ops - 1];
+
+    rc = shutdownBufferPool(&bm);
+    free(mru.lastUse);
+    return rc;
+}
+
+/*
+ * misses of the optimal replacement on the reference string, the floor every strategy is measured against
+ */
+static long long benchOptimalMisses(const BenchConfig *cfg, const Access *refs, int poolSize) {
+    long long *pages = malloc(sizeof(long long) * cfg->ops);
+
+    for (int i = 0; i < cfg->ops; i++)
+        pages[i] = refs[i].pageNum;
+    long long misses = optimalMisses(pages, cfg->ops, poolSize);
+    free(pages);
+    return misses;
+}
+
+/*
+ * nanoseconds per pin+unpin hit of a random resident page, with the pool looking pages up by scan or by table
+ */
+static double lookupNanos(const BenchConfig *cfg, const PageNumber *refs, int poolSize, bool scan) {
+    BM_BufferPool bm;
+    BM_PageHandle h;
+    struct timespec start, end;
+
+    CHECK(initBufferPool(&bm, BENCH_FILE, poolSize, RS_LRU, NULL));
+    CHECK(setLookupThreshold(&bm, scan ? poolSize : 0));
+    for (int i = 0; i < poolSize; i++) {
+        CHECK(pinPage(&bm, &h, i));
+        CHECK(unpinPage(&bm, &h));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < cfg->ops; i++) {
+        pinPage(&bm, &h, refs[i]);
+        unpinPage(&bm, &h);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    CHECK(shutdownBufferPool(&bm));
+    return elapsedNanos(&start, &end) / cfg->ops;
+}
+
+/*
+ * the page table vs frame scan crossover: pool sizes doubling from 8 to lookupFrames, every access a hit
+ */
+static void runLookupBench(const BenchConfig *cfg) {
+    PageNumber *refs = malloc(sizeof(PageNumber) * cfg->ops);
+
+    printf("%8s %10s %10s %8s\n", "frames", "tableNs", "scanNs", "faster");
+    for (int size = 8; size <= cfg->lookupFrames; size *= 2) {
+        rngState = cfg->seed * 2654435761ULL + size;
+        for (int i = 0; i < cfg->ops; i++)
+            refs[i] = (PageNumber) (nextRandom() % size);
+        double table = lookupNanos(cfg, refs, size, FALSE);
+        double scan = lookupNanos(cfg, refs, size, TRUE);
+        printf("%8d %10.1f %10.1f %8s\n", size, table, scan, scan < table ? "scan" : "table");
+    }
+    free(refs);
+}
+
+static RC createBenchFile(int pages) {
+    SM_FileHandle fh;
+    RC rc;
+
+    if ((rc = createPageFile(BENCH_FILE)) != RC_OK)
+        return rc;
+    if ((rc = openPageFile(BENCH_FILE, &fh)) != RC_OK)
+        return rc;
+    rc = ensureCapacity(pages, &fh);
+    closePageFile(&fh);
+    return rc;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-w uniform|zipf|seq|loop|hotscan|index|all] [-n filePages] [-o ops] [-p poolSizes]\n"
+                    "          [-s skew] [-r writeRatio] [-l loopPages] [-k K] [-c window] [-t tierKB] [-x seed]\n"
+                    "       %s -L maxFrames [-o ops] [-x seed]\n", prog, prog);
+    exit(1);
+}
+
+static void parseArgs(int argc, char **argv, BenchConfig *cfg) {
+    cfg->workload = -1;
+    cfg->filePages = 10000;
+    cfg->ops = 50000;
+    cfg->poolSizes[0] = 100;
+    cfg->poolSizes[1] = 1000;
+    cfg->poolSizes[2] = 5000;
+    cfg->numPoolSizes = 3;
+    cfg->skew = 0.99;
+    cfg->writeRatio = 0.2;
+    cfg->loopPages = 0;
+    cfg->k = 2;
+    cfg->cleanFirst = 0;
+    cfg->tierKB = 0;
+    cfg->lookupFrames = 0;
+    cfg->seed = 42;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-' || strlen(argv[i]) != 2 || i + 1 >= argc)
+            usage(argv[0]);
+        char *arg = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 'w':
+                cfg->workload = -2;
+                if (strcmp(arg, "all") == 0)
+                    cfg->workload = -1;
+                for (int w = 0; w < WL_COUNT; w++)
+                    if (strcmp(arg, workloadNames[w]) == 0)
+                        cfg->workload = w;
+                if (cfg->workload == -2)
+                    usage(argv[0]);
+                break;
+            case 'n': cfg->filePages = atoi(arg); break;
+            case 'o': cfg->ops = atoi(arg); break;
+            case 's': cfg->skew = atof(arg); break;
+            case 'r': cfg->writeRatio = atof(arg); break;
+            case 'l': cfg->loopPages = atoi(arg); break;
+            case 'k': cfg->k = atoi(arg); break;
+            case 'c': cfg->cleanFirst = atoi(arg); break;
+            case 't': cfg->tierKB = atol(arg); break;
+            case 'L': cfg->lookupFrames = atoi(arg); break;
+            case 'x': cfg->seed = strtoull(arg, NULL, 10); break;
+            case 'p':
+                cfg->numPoolSizes = 0;
+                for (char *tok = strtok(arg, ","); tok && cfg->numPoolSizes < MAX_POOL_SIZES; tok = strtok(NULL, ","))
+                    cfg->poolSizes[cfg->numPoolSizes++] = atoi(tok);
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (cfg->loopPages <= 0 || cfg->loopPages > cfg->filePages)
+        cfg->loopPages = cfg->filePages / 4 > 0 ? cfg->filePages / 4 : 1;
+    if (cfg->filePages <= 0 || cfg->ops <= 0 || cfg->numPoolSizes == 0 || cfg->k <= 0 || cfg->cleanFirst < 0
+        || cfg->tierKB < 0 || cfg->lookupFrames < 0)
+        usage(argv[0]);
+}
+
+int
+main(int argc, char **argv) {
+    BenchConfig cfg;
+    RunResult r;
+
+    parseArgs(argc, argv, &cfg);
+    initStorageManager();
+    if (cfg.lookupFrames > 0) {
+        CHECK(createBenchFile(cfg.lookupFrames));
+        runLookupBench(&cfg);
+        CHECK(destroyPageFile(BENCH_FILE));
+        return 0;
+    }
+    CHECK(createBenchFile(cfg.filePages));
+
+    double *latencies = malloc(sizeof(double) * cfg.ops);
+
+    printf("%-8s %6s %-6s %8s %8s %8s %8s %8s %10s %8s %8s %8s %8s %8s\n", "workload", "pool", "strat", "hit%",
+           "optGap", "reads", "writes", "dirtyEv", "ops/s", "p50us", "p90us", "p99us", "maxus", "idxMiss%");
+    for (int w = 0; w < WL_COUNT; w++) {
+        if (cfg.workload >= 0 && cfg.workload != w)
+            continue;
+        Access *refs = makeWorkload(&cfg, w);
+
+        for (int p = 0; p < cfg.numPoolSizes; p++) {
+            // OPT only has a hit ratio; optGap is how many points of hit ratio a strategy loses to it
+            long long optMisses = benchOptimalMisses(&cfg, refs, cfg.poolSizes[p]);
+            double optHit = 100.0 * (cfg.ops - optMisses) / cfg.ops;
+            printf("%-8s %6d %-6s %8.2f %8.2f %8lld\n", workloadNames[w], cfg.poolSizes[p], "OPT", optHit, 0.0,
+                   optMisses);
+            for (int s = 0; s < NUM_STRATEGIES; s++) {
+                // the index workload runs the built-in strategies once more, pinning with its hints
+                int runs = w == WL_INDEX && strategies[s] != RS_CUSTOM ? 2 : 1;
+                for (int hinted = 0; hinted < runs; hinted++) {
+                    CHECK(runOne(&cfg, refs, strategies[s], hinted, cfg.poolSizes[p], latencies, &r));
+                    double hit = 100.0 * (cfg.ops - r.reads) / cfg.ops;
+                    printf("%-8s %6d %-6s %8.2f %8.2f %8d %8d %8lld %10.0f %8.2f %8.2f %8.2f %8.2f",
+                           workloadNames[w], cfg.poolSizes[p], hinted ? hintedNames[s] : strategyNames[s], hit,
+                           optHit - hit, r.reads, r.writes, r.dirtyEvictions, cfg.ops / r.seconds, r.p50, r.p90,
+                           r.p99, r.max);
+                    if (r.indexPins > 0)
+                        printf(" %8.2f\n", 100.0 * r.indexMisses / r.indexPins);
+                    else
+                        printf(" %8s\n", "-");
+                }
+            }
+        }
+        free(refs);
+    }
+
+    free(latencies);
+    CHECK(destroyPageFile(BENCH_FILE));
+    return 0;
+}
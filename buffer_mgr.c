@@ -3,36 +3,554 @@
 //
 #include "buffer_mgr.h"
 #include "storage_mgr.h"
+#include "buffer_mgr_trace.h"
+#include "compressed_tier.h"
+#include "async_read.h"
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BM_SIMD_SCAN
+#endif
+
+// Statistics are on unless the pool is built with -DBM_NO_STATS.
+// Counters are exact; only every STATS_HIT_SAMPLE'th pin hit is timed, as timing a hit costs about as much as the hit.
+#define STATS_HIT_SAMPLE 16
+#ifndef BM_NO_STATS
+#define STATS_NOW() nowNanos()
+#define STATS_COUNT(meta, counter) ((meta)->stats.counter++)
+#define STATS_ADD(meta, counter, nanos) ((meta)->stats.counter += (nanos))
+#define STATS_RECORD(meta, hist, start) recordLatency(&(meta)->stats.hist, nowNanos() - (start))
+#define STATS_RECORD_NANOS(meta, hist, nanos) recordLatency(&(meta)->stats.hist, (nanos))
+#define STATS_SAMPLE_HIT(meta) (++(meta)->hitSample % STATS_HIT_SAMPLE == 0)
+#else
+#define STATS_NOW() 0LL
+#define STATS_COUNT(meta, counter) ((void) 0)
+#define STATS_ADD(meta, counter, nanos) ((void) 0)
+#define STATS_RECORD(meta, hist, start) ((void) 0)
+#define STATS_RECORD_NANOS(meta, hist, nanos) ((void) 0)
+#define STATS_SAMPLE_HIT(meta) 0
+#endif
+
+// Pools of up to BM_SCAN_FRAMES frames find pages by scanning a dense array of the frames' page numbers (SIMD where
+// the CPU has it) rather than through the page table. The page table is open addressing over a flat array, so there
+// is no pointer chasing for the scan to win back: on the AVX2 machine `bench_buffer_mgr -L` was tuned on, the table
+// took about 5ns a lookup at every pool size and the scan 8-12ns at 8 frames, losing more from there. So the scan is
+// off by default; setLookupThreshold turns it on for pools where the benchmark says it pays.
+#define BM_SCAN_FRAMES 0
+
+// pages pinned with BM_HINT_RESIDENT may take up to this many percent of the frames, see setResidentShare
+#define BM_RESIDENT_SHARE 20
+// the hint pinPage pins with: a page that's already in the pool keeps its hint, a new one is BM_HINT_NORMAL
+#define HINT_KEEP -1
 
 
 // PageFrame is statically allocated
 // BM_PageHandle is statically allocated
-// The page data (frame.data) is dynamically allocated
+// The page data (frame.data) is dynamically allocated, and not freed while an optimistic read is open (see retireBuffer)
+// Its replacement state (fix count, dirty flag, counter, LRU_K history) lives in Metadata's per-frame arrays
 typedef struct PageFrame {
     BM_PageHandle frame; // the in-memory page
-    bool dirty;
-    int fixcount;
-    int counter;     // if it's FIFO, when this page was written into memory
-                     // if it's LRU, when this page was last used
-                     // if it's CLOCK, this is either 0 or 1
-                     // if it's LFU, increment whenever a page pins it
-
-    // for LFU-K, an array of timestamps for the last access
-    int *accesses;
+    int dataSize;    // size of the frame.data buffer, the page size of the file it was last used for
+    int fileId;      // which registered page file frame.pageNum belongs to
+
+    // sequence counter for optimistic reads; odd while the frame is being replaced or read in, bumped by 2 when the
+    // page is marked dirty or leaves the frame
+    unsigned int version;
+
+    // dirty page table entry, only meaningful while the frame is dirty
+    long long dirtySince; // when the page became dirty (since its last write)
+    long long dirtyLsn;   // the order pages became dirty in
+    int dirtyPrev;        // neighbours in the dirty list, -1 at the ends
+    int dirtyNext;
+
+    // where the frame is in the eviction candidate heap, -1 if it isn't (pinned, free, or the pool uses CLOCK)
+    int candidatePos;
+
+    // the background read filling the frame, NULL if there is none (see pinPageAsync)
+    struct PendingRead *reading;
 } PageFrame;
 
+// A page file the pool caches pages for. The handle stays open for as long as the file is registered.
+typedef struct PageFile {
+    char *fileName;  // NULL if the slot is unused
+    SM_FileHandle fh;
+    int unsynced;    // pages written since the file's last sync
+} PageFile;
+
+// an asynchronous pin waiting for its page to be read
+typedef struct PinWaiter {
+    BM_PinCallback callback;
+    void *ctx;
+    struct PinWaiter *next;
+} PinWaiter;
+
+// a page being read in the background, and every asynchronous pin waiting for it. Each waiter holds one of the
+// frame's pins, so the frame can't be ejected while the read is out.
+typedef struct PendingRead {
+    AsyncRead read;      // first, so a collected read is its PendingRead
+    int frame;
+    PinWaiter *waiters;  // in the order the pins came in
+    PinWaiter **lastWaiter;
+} PendingRead;
+
+// a page a prewarm still has to load, see prewarmBufferPool
+typedef struct WarmPage {
+    PageNumber pageNum;
+    int hint;
+    int rank;       // its place in the warm state, 0 for the hottest page
+} WarmPage;
+
+// finds the frame holding a page by scanning Metadata.pageNums, see pickFrameScan
+struct Metadata;
+typedef int (*FrameScan)(const struct Metadata *meta, int n, int fileId, PageNumber pageNum);
+
+// a replacement strategy's bookkeeping, picked once by initBufferPool so pins don't test the strategy (see policies)
+typedef struct ReplacementPolicy {
+    void (*touch)(struct Metadata *meta, int i);   // the page in frame i was pinned again
+    void (*admit)(struct Metadata *meta, int i);   // frame i was just loaded with a new page
+    void (*take)(struct Metadata *meta, int i, bool wasFree); // frame i was taken for a new page: free, or the victim
+    PageFrame *(*victim)(BM_BufferPool *const bm); // the frame to eject next, NULL if every page is fixed
+    bool usesHeap;                                 // keeps the candidate heap (FIFO, LRU, LFU, LRU_K)
+    bool usesHand;                                 // curCounter is a frame index (CLOCK's hand), see resizeBufferPool
+    bool stampsPages;                              // admit stamps curCounter on the page (FIFO, LRU, LRU_K)
+} ReplacementPolicy;
+static const ReplacementPolicy policies[RS_CUSTOM + 1];
+
 typedef struct Metadata {
     PageFrame *frames; // array of frames
     int curCounter;    // used by FIFO/LRU/CLOCK to set their counter
                        // FIFO: curCounter maintains the count of memory accesses
                        // LRU: curCounter maintains the list of pinning
                        // CLOCK: this is simply the index of the current frame we're looking at
+    int lruK;          // LRU_K: how many accesses each frame remembers
+    const ReplacementPolicy *policy;
+    BM_CustomStrategy *custom;  // RS_CUSTOM: the client's callbacks, a copy of stratData; NULL otherwise
+    int cleanFirstWindow; // evict clean frames first among this many coldest candidates, 0 for off
+
+    // file registry, indexed by fileId. fileId 0 is bm->pageFile
+    PageFile *files;
+    int numFiles;
+
+    // dirty page table: the dirty frames, ordered by when they became dirty (oldest at dirtyHead)
+    int dirtyHead;
+    int dirtyTail;
+    long long dirtyLsn;       // the last dirtyLsn handed out
+
+    // incremental checkpoint: writes every page that was dirty at its start, spread evenly over checkpointNanos
+    bool checkpointing;
+    long long checkpointLsn;  // pages with a dirtyLsn up to this one belong to the checkpoint
+    long long checkpointStart;
+    long long checkpointNanos;
+    int checkpointTotal;
+    int checkpointLeft;       // pages of the checkpoint that are still dirty
+
+    // page buffers no frame uses at the moment, kept while an optimistic read is open (see retireBuffer)
+    char **spareBuffers;
+    int *spareSizes;
+    int numSpare;
+    int numOptimisticReads;   // begun without a pin and not validated yet
+    long long bufferBytes;    // page buffers allocated, spares included
+
+    // compressed victim tier, NULL unless setCompressedTier was called
+    CompressedTier *tier;
+
+    // group sync: writes are issued right away, and up to syncBatch of them (or syncDelay worth) share one sync
+    int syncBatch;            // 0 if group sync is off
+    long long syncDelayNanos;
+    int unsyncedWrites;       // over all files
+    long long firstUnsynced;  // when the oldest unsynced write was issued
+
+    // eviction candidates: a min-heap of the resident unpinned frames, coldest (see colderFrame) at the top, so a miss
+    // costs O(log candidates) no matter how many frames are pinned. CLOCK sweeps the frames instead.
+    int *candidates;   // frame indices
+    int numCandidates;
+    const int *heapKeys;  // the heap orders frame i by heapKeys[i * heapKeyStride]; NULL for CLOCK
+    int heapKeyStride;
+    int *frontier;     // scratch for visiting the coldest candidates in order (clean-first window)
+    int frontierSize;
+
+    // page table: open addressing over frame indices, keyed by (fileId, pageNum)
+    int *table;        // -1 if the slot is empty
+    int tableMask;     // table size - 1; the size is a power of two
+
+    // the same index as a dense, 32 byte aligned array: the page number of every frame, NO_PAGE if it's free,
+    // padded with NO_PAGE to a multiple of 8 frames. Small pools scan it instead of probing the table.
+    PageNumber *pageNums;
+    int scanThreshold;  // scan if the pool has at most this many frames
+    FrameScan scanFrames;
+
+    // warm state: whether shutdown dumps the resident pages, and the pages a prewarm still has to load
+    bool dumpWarmState;
+    WarmPage *prewarmQueue;  // sorted by page number
+    int prewarmLen;
+    int prewarmPos;
+    int prewarmFile;
+    int prewarmStamp;        // the counter the hottest page gets, see prewarmBufferPool
+
+    // access trace, NULL unless startTrace was called
+    BM_TraceWriter *trace;
+
+    // background reads for pinPageAsync, NULL until the first asynchronous miss
+    AsyncReader *reader;
+    int inFlight;      // reads submitted and not yet completed by pollAsyncPins
 
     // add statistics here
     int numRead;
     int numWrite;
+    BM_PoolStatistics stats;
+    unsigned int hitSample; // picks the pin hits that get timed
+
+    // per-frame state, struct-of-arrays: a pass that needs one field (victim search, flushes, stats) only touches
+    // that field's array. The LRU_K history is cold and sits in a block of its own.
+    int *fixCounts;
+    int *counters;     // FIFO: when the page was loaded, LRU: when it was last used, CLOCK: the reference bit (0 or
+                       // 1), LFU: how often it was pinned
+    int *history;      // LRU_K: lruK accesses per frame, newest first (0 if there were fewer); NULL otherwise
+    unsigned char *hints;            // frame i's BM_PageHint; BM_HINT_NORMAL if the frame is free
+    unsigned long long *dirtyBits;   // bit i set if frame i is dirty
+    unsigned long long *pinnedBits;  // bit i set if frame i's fix count is above 0
+
+    // free frame count, kept up to date on every state change; pinned and dirty frames are counted off the bitsets
+    int numFree;       // also the size of freeFrames
+    int numResident;   // frames tagged BM_HINT_RESIDENT
+    int residentShare; // percent of the frames that may be tagged BM_HINT_RESIDENT
+
+    // the free frames as a stack, so a miss finds one without a scan. A rebuild puts the lowest frame on top.
+    int *freeFrames;
 } Metadata;
+
+static long long nowNanos(void){
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+/*
+ * adds a latency to its log2 bucket: bucket i holds [2^i, 2^(i+1)) ns, bucket 0 also holds 0ns
+ */
+static void recordLatency(BM_Histogram *h, long long nanos){
+    int bucket = 0;
+
+    if(nanos < 0)
+        nanos = 0;
+    if(nanos > 0)
+        bucket = 63 - __builtin_clzll((unsigned long long) nanos);
+    if(bucket >= BM_HISTOGRAM_BUCKETS)
+        bucket = BM_HISTOGRAM_BUCKETS - 1;
+    h->buckets[bucket]++;
+    h->count++;
+    h->totalNanos += nanos;
+}
+
+/*
+ * the page table's hash of a (fileId, pageNum) key
+ */
+static unsigned int hashPage(int fileId, PageNumber pageNum){
+    unsigned int h = (unsigned int) pageNum * 2654435761u;
+    h ^= (unsigned int) fileId * 2246822519u;
+    return h ^ (h >> 16);
+}
+
+static void tableInsert(Metadata *const meta, int frameIndex){
+    PageFrame *p = &meta->frames[frameIndex];
+    unsigned int i = hashPage(p->fileId, p->frame.pageNum) & meta->tableMask;
+
+    while(meta->table[i] != -1)
+        i = (i + 1) & meta->tableMask;
+    meta->table[i] = frameIndex;
+    meta->pageNums[frameIndex] = p->frame.pageNum;
+}
+
+/*
+ * linear probing delete; shifts the following entries back so lookups never need tombstones
+ */
+static void tableRemove(Metadata *const meta, int frameIndex){
+    unsigned int mask = meta->tableMask;
+    PageFrame *p = &meta->frames[frameIndex];
+    unsigned int i = hashPage(p->fileId, p->frame.pageNum) & mask;
+
+    meta->pageNums[frameIndex] = NO_PAGE;
+    while(meta->table[i] != frameIndex){
+        if(meta->table[i] == -1)
+            return; // not in the table
+        i = (i + 1) & mask;
+    }
+
+    unsigned int j = i;
+    while(true){
+        j = (j + 1) & mask;
+        if(meta->table[j] == -1)
+            break;
+        PageFrame *q = &meta->frames[meta->table[j]];
+        unsigned int home = hashPage(q->fileId, q->frame.pageNum) & mask;
+        // move table[j] into the hole at i, unless its home slot lies cyclically in (i, j]
+        if(((j - home) & mask) >= ((j - i) & mask)){
+            meta->table[i] = meta->table[j];
+            i = j;
+        }
+    }
+    meta->table[i] = -1;
+}
+
+/*
+ * (re)allocates the page table and the page number array for numPages frames and inserts every resident frame
+ *  the table is kept at most half full
+ */
+static void rebuildTable(Metadata *const meta, int numPages){
+    int tableSize = 16;
+    while(tableSize < 2 * numPages)
+        tableSize *= 2;
+
+    int padded = (numPages + 7) & ~7;
+    free(meta->pageNums);
+    meta->pageNums = aligned_alloc(32, sizeof(PageNumber) * (padded > 0 ? padded : 8));
+    for(int i = 0; i < padded; i++)
+        meta->pageNums[i] = NO_PAGE;
+
+    free(meta->table);
+    meta->table = malloc(sizeof(int) * tableSize);
+    meta->tableMask = tableSize - 1;
+    for(int i = 0; i < tableSize; i++)
+        meta->table[i] = -1;
+    for(int i = 0; i < numPages; i++)
+        if(meta->frames[i].frame.pageNum != NO_PAGE)
+            tableInsert(meta, i);
+}
+
+/*
+ * Frame scans: the index of the frame holding (fileId, pageNum), or -1, looking at the first n entries of pageNums
+ *  n is a multiple of 8. Free frames are NO_PAGE, so pageNum must not be.
+ */
+static int scanFramesScalar(const Metadata *meta, int n, int fileId, PageNumber pageNum){
+    for(int i = 0; i < n; i++)
+        if(meta->pageNums[i] == pageNum && meta->frames[i].fileId == fileId)
+            return i;
+    return -1;
+}
+#ifdef BM_SIMD_SCAN
+static int scanFramesSse2(const Metadata *meta, int n, int fileId, PageNumber pageNum){
+    __m128i key = _mm_set1_epi32(pageNum);
+
+    for(int i = 0; i < n; i += 16){
+        unsigned int mask = 0;
+        for(int j = 0; j < 16 && i + j < n; j += 4){
+            __m128i v = _mm_load_si128((const __m128i *) (meta->pageNums + i + j));
+            mask |= (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, key))) << j;
+        }
+        for(; mask; mask &= mask - 1){
+            int f = i + __builtin_ctz(mask);
+            if(meta->frames[f].fileId == fileId)
+                return f;
+        }
+    }
+    return -1;
+}
+__attribute__((target("avx2")))
+static int scanFramesAvx2(const Metadata *meta, int n, int fileId, PageNumber pageNum){
+    __m256i key = _mm256_set1_epi32(pageNum);
+
+    // 32 frames per step, so there's one hard to predict branch per 32 frames rather than per 8
+    for(int i = 0; i < n; i += 32){
+        unsigned int mask = 0;
+        for(int j = 0; j < 32 && i + j < n; j += 8){
+            __m256i v = _mm256_load_si256((const __m256i *) (meta->pageNums + i + j));
+            mask |= (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(v, key))) << j;
+        }
+        for(; mask; mask &= mask - 1){
+            int f = i + __builtin_ctz(mask);
+            if(meta->frames[f].fileId == fileId)
+                return f;
+        }
+    }
+    return -1;
+}
+#endif
+/*
+ * the best scan the CPU can run
+ */
+static FrameScan pickFrameScan(void){
+#ifdef BM_SIMD_SCAN
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+        return scanFramesAvx2;
+    if(__builtin_cpu_supports("sse2"))
+        return scanFramesSse2;
+    return scanFramesScalar;
+#else
+    return scanFramesScalar;
+#endif
+}
+#define BIT_WORDS(n) (((n) + 63) / 64)
+
+static bool testBit(const unsigned long long *bits, int i){
+    return (bits[i >> 6] >> (i & 63)) & 1;
+}
+static void setBit(unsigned long long *bits, int i){
+    bits[i >> 6] |= 1ULL << (i & 63);
+}
+static void clearBit(unsigned long long *bits, int i){
+    bits[i >> 6] &= ~(1ULL << (i & 63));
+}
+/*
+ * the number of set bits among the first n, ie pinned or dirty frames
+ */
+static int countBits(const unsigned long long *bits, int n){
+    int count = 0;
+    for(int w = 0; w < BIT_WORDS(n); w++)
+        count += __builtin_popcountll(bits[w]);
+    return count;
+}
+
+static int frameIndex(const Metadata *meta, const PageFrame *p){
+    return (int) (p - meta->frames);
+}
+static bool isDirty(const Metadata *meta, const PageFrame *p){
+    return testBit(meta->dirtyBits, frameIndex(meta, p));
+}
+static int *historyOf(const Metadata *meta, int i){
+    return meta->history + (long) i * meta->lruK;
+}
+/*
+ * grows or shrinks the per-frame state arrays from oldNumPages to numPages frames; new frames are free
+ *  Shrinking just cuts the arrays: the frames that go away have to be free (and their bits clear) by then.
+ */
+static void resizeFrameState(Metadata *const meta, int oldNumPages, int numPages){
+    int oldWords = oldNumPages > 0 ? BIT_WORDS(oldNumPages) : 0, words = BIT_WORDS(numPages);
+
+    meta->fixCounts = realloc(meta->fixCounts, sizeof(int) * numPages);
+    meta->counters = realloc(meta->counters, sizeof(int) * numPages);
+    meta->hints = realloc(meta->hints, numPages);
+    for(int i = oldNumPages; i < numPages; i++){
+        meta->fixCounts[i] = 0;
+        meta->counters[i] = -1;
+        meta->hints[i] = BM_HINT_NORMAL;
+    }
+    if(meta->lruK > 0){
+        meta->history = realloc(meta->history, sizeof(int) * meta->lruK * numPages);
+        if(numPages > oldNumPages)
+            memset(historyOf(meta, oldNumPages), 0, sizeof(int) * meta->lruK * (numPages - oldNumPages));
+    }
+    meta->dirtyBits = realloc(meta->dirtyBits, sizeof(unsigned long long) * words);
+    meta->pinnedBits = realloc(meta->pinnedBits, sizeof(unsigned long long) * words);
+    for(int w = oldWords; w < words; w++)
+        meta->dirtyBits[w] = meta->pinnedBits[w] = 0;
+
+    // the arrays may have moved; LRU_K orders by the K'th newest access, the others by the counter
+    meta->heapKeys = NULL;
+    meta->heapKeyStride = 1;
+    if(meta->policy->usesHeap && meta->lruK > 0){
+        meta->heapKeys = meta->history + meta->lruK - 1;
+        meta->heapKeyStride = meta->lruK;
+    } else if(meta->policy->usesHeap)
+        meta->heapKeys = meta->counters;
+}
+/*
+ * moves frame from's replacement state to frame to, which has to be free
+ */
+static void moveFrameState(Metadata *const meta, int from, int to){
+    meta->fixCounts[to] = meta->fixCounts[from];
+    meta->counters[to] = meta->counters[from];
+    meta->hints[to] = meta->hints[from];
+    meta->hints[from] = BM_HINT_NORMAL;
+    if(meta->lruK > 0)
+        memcpy(historyOf(meta, to), historyOf(meta, from), sizeof(int) * meta->lruK);
+    if(testBit(meta->dirtyBits, from))
+        setBit(meta->dirtyBits, to);
+    if(testBit(meta->pinnedBits, from))
+        setBit(meta->pinnedBits, to);
+    clearBit(meta->dirtyBits, from);
+    clearBit(meta->pinnedBits, from);
+    meta->fixCounts[from] = 0;
+}
+/*
+ * rebuilds the free frame stack from scratch
+ */
+static void recountFrames(Metadata *const meta, int numPages){
+    free(meta->freeFrames);
+    meta->freeFrames = malloc(sizeof(int) * numPages);
+    meta->numFree = 0;
+    for(int i = numPages - 1; i >= 0; i--)
+        if(meta->frames[i].frame.pageNum == NO_PAGE)
+            meta->freeFrames[meta->numFree++] = i;
+}
+
+static void pushFreeFrame(Metadata *const meta, PageFrame *p){
+    meta->freeFrames[meta->numFree++] = (int) (p - meta->frames);
+}
+/*
+ * takes a free frame off the stack, or NULL if the pool is full
+ */
+static PageFrame *popFreeFrame(Metadata *const meta){
+    if(meta->numFree == 0)
+        return NULL;
+    return &meta->frames[meta->freeFrames[--meta->numFree]];
+}
+
+/*
+ * A buffer a frame gives up is freed, unless an optimistic read is open: the reader may still look at the buffer it
+ * got from beginOptimisticRead, so the buffer is kept here until the last open read is validated (see freeSpares),
+ * and handed to the next frame that needs that size meanwhile. The reader then sees some other page's bytes, but
+ * never freed memory, and its validation fails.
+ */
+static void retireBuffer(Metadata *const meta, char *data, int size){
+    if(!data)
+        return;
+    if(meta->numOptimisticReads == 0){
+        free(data);
+        meta->bufferBytes -= size;
+        return;
+    }
+    meta->spareBuffers = realloc(meta->spareBuffers, sizeof(char *) * (meta->numSpare + 1));
+    meta->spareSizes = realloc(meta->spareSizes, sizeof(int) * (meta->numSpare + 1));
+    meta->spareBuffers[meta->numSpare] = data;
+    meta->spareSizes[meta->numSpare++] = size;
+}
+/*
+ * a buffer of size bytes: a spare one if there is one, else a new one
+ */
+static char *takeBuffer(Metadata *const meta, int size){
+    for(int i = meta->numSpare - 1; i >= 0; i--){
+        if(meta->spareSizes[i] != size)
+            continue;
+        char *data = meta->spareBuffers[i];
+        meta->spareBuffers[i] = meta->spareBuffers[--meta->numSpare];
+        meta->spareSizes[i] = meta->spareSizes[meta->numSpare];
+        return data;
+    }
+    meta->bufferBytes += size;
+    return malloc(size);
+}
+/*
+ * frees the spare buffers, once no optimistic reader can look at them
+ */
+static void freeSpares(Metadata *const meta){
+    for(int i = 0; i < meta->numSpare; i++){
+        free(meta->spareBuffers[i]);
+        meta->bufferBytes -= meta->spareSizes[i];
+    }
+    meta->numSpare = 0;
+}
+
+static PageFile *getFile(Metadata *const meta, int fileId){
+    if(fileId < 0 || fileId >= meta->numFiles || !meta->files[fileId].fileName)
+        return NULL;
+    return &meta->files[fileId];
+}
+/*
+ * the storage manager's handles are shared with the background reader, if there is one: every storage call on them
+ * holds its I/O latch
+ */
+static void lockIO(Metadata *const meta){
+    if(meta->reader)
+        asyncLockIO(meta->reader);
+}
+static void unlockIO(Metadata *const meta){
+    if(meta->reader)
+        asyncUnlockIO(meta->reader);
+}
+static void drainAsyncPins(BM_BufferPool *const bm);
+
 /*
  * Creates a new buffer pool for an existing page file
  *  New Buffer Pool bp
@@ -40,36 +558,115 @@ typedef struct Metadata {
  *      bp->strategy = strategy
  *      handles the page pageFileName
  *      Page Frames should be empty
- *      PageFile should already exist and be open
- *      stratData would be used for [EC] replacement strategies. Not necessary atm.
+ *      PageFile should already exist; it is registered as fileId 0 and kept open until shutdown
+ *      stratData depends on the strategy: for RS_LRU_K it holds K, cast to a pointer (NULL for LRU-2); for RS_CUSTOM
+ *      it points to the client's BM_CustomStrategy (chooseVictim required), which is copied. The others ignore it.
  */
 RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
                   const int numPages, ReplacementStrategy strategy,
                   void *stratData){
-    bm->pageFile = pageFileName;
+    BM_CustomStrategy *custom = stratData;
+
+    if(strategy < RS_FIFO || strategy > RS_CUSTOM)
+        return RC_WRITE_FAILED;
+    if(strategy == RS_CUSTOM && (!custom || !custom->chooseVictim))
+        return RC_WRITE_FAILED;
+    bm->pageFile = (char *) pageFileName;
     bm->numPages = numPages;
 
     bm->strategy = strategy;
 
     Metadata *m = malloc(sizeof(struct Metadata));
+    m->policy = &policies[strategy];
+    m->custom = NULL;
+    if(strategy == RS_CUSTOM){
+        m->custom = malloc(sizeof(BM_CustomStrategy));
+        *m->custom = *custom;
+    }
     m->frames = malloc(sizeof(PageFrame) * numPages);
     m->numRead = 0;
     m->numWrite = 0;
+    memset(&m->stats, 0, sizeof(BM_PoolStatistics));
+    m->hitSample = 0;
 
     // init the pageframes as empty
     for(int i = 0; i < bm->numPages; i++){
         m->frames[i].frame = (BM_PageHandle){NO_PAGE, NULL};
-        m->frames[i].dirty = FALSE;
-        m->frames[i].fixcount = 0;
-        m->frames[i].counter = -1;
-        if(strategy == RS_LRU_K)
-            m->frames[i].accesses = calloc((int)stratData, sizeof(int));
-    }
-    if(strategy == RS_LRU_K)
-        m->curCounter = (int)stratData;
-    else
-        m->curCounter = 1;
+        m->frames[i].dataSize = 0;
+        m->frames[i].fileId = BM_DEFAULT_FILE;
+        m->frames[i].version = 0;
+        m->frames[i].dirtyPrev = m->frames[i].dirtyNext = -1;
+        m->frames[i].candidatePos = -1;
+        m->frames[i].reading = NULL;
+    }
+    m->candidates = malloc(sizeof(int) * numPages);
+    m->numCandidates = 0;
+    m->frontier = NULL;
+    m->frontierSize = 0;
+    m->curCounter = 1;
+    m->lruK = 0;
+    m->cleanFirstWindow = 0;
+    m->dirtyHead = m->dirtyTail = -1;
+    m->dirtyLsn = 0;
+    m->checkpointing = FALSE;
+    m->checkpointLeft = m->checkpointTotal = 0;
+    m->spareBuffers = NULL;
+    m->spareSizes = NULL;
+    m->numSpare = 0;
+    m->numOptimisticReads = 0;
+    m->bufferBytes = 0;
+    m->tier = NULL;
+    m->syncBatch = 0;
+    m->syncDelayNanos = 0;
+    m->unsyncedWrites = 0;
+    m->firstUnsynced = 0;
+    if(strategy == RS_LRU_K) // stratData holds K; plain LRU-2 if the client didn't give one
+        m->lruK = stratData ? (int)(long)stratData : 2;
+    m->fixCounts = m->counters = m->history = NULL;
+    m->hints = NULL;
+    m->dirtyBits = m->pinnedBits = NULL;
+    m->numResident = 0;
+    m->residentShare = BM_RESIDENT_SHARE;
+    resizeFrameState(m, 0, numPages);
+
+    m->table = NULL;
+    m->pageNums = NULL;
+    m->scanThreshold = BM_SCAN_FRAMES;
+    m->scanFrames = pickFrameScan();
+    m->freeFrames = NULL;
+    rebuildTable(m, numPages);
+    recountFrames(m, numPages);
+
+    m->numFiles = 0;
+    m->files = NULL;
+    m->dumpWarmState = FALSE;
+    m->prewarmQueue = NULL;
+    m->prewarmLen = m->prewarmPos = 0;
+    m->prewarmFile = BM_DEFAULT_FILE;
+    m->trace = NULL;
+    m->reader = NULL;
+    m->inFlight = 0;
     bm->mgmtData = m;
+
+    int fileId;
+    if(registerPageFile(bm, pageFileName, &fileId) != RC_OK){
+        free(m->frames);
+        free(m->fixCounts);
+        free(m->counters);
+        free(m->hints);
+        free(m->history);
+        free(m->dirtyBits);
+        free(m->pinnedBits);
+        free(m->candidates);
+        free(m->freeFrames);
+        free(m->table);
+        free(m->pageNums);
+        free(m->files);
+        free(m->custom);
+        free(m);
+        bm->mgmtData = NULL;
+        return RC_FILE_NOT_FOUND;
+    }
     return RC_OK;
 }
 /*
@@ -77,71 +674,991 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
  *  Throw error if any pages are pinned
  *  call forceFlushPool
  *  Free the memory given to pages
+ *  Close every registered page file
  */
 RC shutdownBufferPool(BM_BufferPool *const bm){
     Metadata *meta = bm->mgmtData;
     PageFrame *pages = meta->frames;
+    // pins still waiting for a read hand their pages to the client first, who then has to unpin them
+    drainAsyncPins(bm);
     // verify no pages are pinned
-    for(int i = 0; i < bm->numPages; i++)
-        if (pages[i].fixcount > 0)
-            return RC_WRITE_FAILED; // None of the errors describe this failure
+    if (countBits(meta->pinnedBits, bm->numPages) > 0)
+        return RC_WRITE_FAILED; // None of the errors describe this failure
 
     // write all dirty pages
     if (forceFlushPool(bm) != RC_OK)
         return RC_WRITE_FAILED;
+    // remember what was hot for the next prewarm. Losing the warm state isn't worth failing the shutdown over.
+    if (meta->dumpWarmState)
+        dumpPoolState(bm);
+    stopTrace(bm);
+    stopAsyncReader(meta->reader);
+    meta->reader = NULL;
     // free the page data
     for(int i = 0; i < bm->numPages; i++) {
         if (pages[i].frame.data) // else it was never used and thus malloc'd, so we can't free.
             free(pages[i].frame.data);
     }
-    free(pages);
-    free(bm->mgmtData);
+    freeSpares(meta);
+    free(meta->spareBuffers);
+    free(meta->spareSizes);
+    for(int i = 0; i < meta->numFiles; i++){
+        if(!meta->files[i].fileName)
+            continue;
+        closePageFile(&meta->files[i].fh);
+        free(meta->files[i].fileName);
+    }
+    free(meta->files);
+    free(meta->table);
+    free(meta->pageNums);
+    free(meta->candidates);
+    free(meta->frontier);
+    free(meta->freeFrames);
+    free(meta->fixCounts);
+    free(meta->counters);
+    free(meta->hints);
+    free(meta->history);
+    free(meta->dirtyBits);
+    free(meta->pinnedBits);
+    free(meta->custom);
+    free(meta->prewarmQueue);
+    freeCompressedTier(meta->tier);
+    free(pages);
+    free(bm->mgmtData);
+    return RC_OK;
+}
+/*
+ * marks the frame dirty and appends it to the dirty page table
+ */
+static void setDirty(Metadata *const meta, PageFrame *p){
+    int i = frameIndex(meta, p);
+
+    if(testBit(meta->dirtyBits, i))
+        return;
+    setBit(meta->dirtyBits, i);
+    p->dirtySince = nowNanos();
+    p->dirtyLsn = ++meta->dirtyLsn;
+    p->dirtyPrev = meta->dirtyTail;
+    p->dirtyNext = -1;
+    if(meta->dirtyTail != -1)
+        meta->frames[meta->dirtyTail].dirtyNext = i;
+    else
+        meta->dirtyHead = i;
+    meta->dirtyTail = i;
+}
+/*
+ * marks the frame clean and takes it off the dirty page table
+ */
+static void setClean(Metadata *const meta, PageFrame *p){
+    int i = frameIndex(meta, p);
+
+    if(!testBit(meta->dirtyBits, i))
+        return;
+    clearBit(meta->dirtyBits, i);
+    if(p->dirtyPrev != -1)
+        meta->frames[p->dirtyPrev].dirtyNext = p->dirtyNext;
+    else
+        meta->dirtyHead = p->dirtyNext;
+    if(p->dirtyNext != -1)
+        meta->frames[p->dirtyNext].dirtyPrev = p->dirtyPrev;
+    else
+        meta->dirtyTail = p->dirtyPrev;
+    p->dirtyPrev = p->dirtyNext = -1;
+    if(meta->checkpointing && p->dirtyLsn <= meta->checkpointLsn)
+        meta->checkpointLeft--;
+}
+/*
+ * puts a page whose write failed back on the dirty page table, in the place it had before setClean took it off
+ *  It keeps its dirtyLsn, so it still belongs to a running checkpoint.
+ */
+static void restoreDirty(Metadata *const meta, PageFrame *p, long long since, long long lsn){
+    int i = frameIndex(meta, p);
+    int prev = meta->dirtyTail;
+
+    while(prev != -1 && meta->frames[prev].dirtyLsn > lsn)
+        prev = meta->frames[prev].dirtyPrev;
+    setBit(meta->dirtyBits, i);
+    p->dirtySince = since;
+    p->dirtyLsn = lsn;
+    p->dirtyPrev = prev;
+    p->dirtyNext = prev != -1 ? meta->frames[prev].dirtyNext : meta->dirtyHead;
+    if(p->dirtyNext != -1)
+        meta->frames[p->dirtyNext].dirtyPrev = i;
+    else
+        meta->dirtyTail = i;
+    if(prev != -1)
+        meta->frames[prev].dirtyNext = i;
+    else
+        meta->dirtyHead = i;
+    if(meta->checkpointing && lsn <= meta->checkpointLsn)
+        meta->checkpointLeft++;
+}
+/*
+ * syncs the file if anything was written to it since its last sync
+ */
+static RC syncFile(Metadata *const meta, PageFile *f){
+    if(f->unsynced == 0)
+        return RC_OK;
+
+    long long start = STATS_NOW();
+    lockIO(meta);
+    RC rc = syncPageFile(&f->fh);
+    unlockIO(meta);
+    if(rc != RC_OK)
+        return RC_WRITE_FAILED;
+    STATS_RECORD(meta, syncIO, start);
+    STATS_COUNT(meta, syncs);
+    meta->unsyncedWrites -= f->unsynced;
+    f->unsynced = 0;
+    if(meta->unsyncedWrites == 0)
+        meta->firstUnsynced = 0;
+    return RC_OK;
+}
+/*
+ * syncs every file with unsynced writes: one fdatasync per file, however many pages were written to it
+ */
+static RC syncAllFiles(Metadata *const meta){
+    for(int i = 0; i < meta->numFiles; i++)
+        if(meta->files[i].fileName && syncFile(meta, &meta->files[i]) != RC_OK)
+            return RC_WRITE_FAILED;
+    return RC_OK;
+}
+/*
+ * Writes the frame's page to its page file and marks it clean
+ *  The page is marked clean before the write and written straight from the frame, pinned or not: the pool runs on
+ *  one thread, so whatever its holder changed before the flush is in the write, and a markDirty after it dirties the
+ *  page again. A write that fails puts the page back on the dirty page table.
+ *  With group sync on, the write joins the current group, which is synced once it holds syncBatch writes or its
+ *  oldest write is syncDelay old.
+ */
+static RC writeFrame(BM_BufferPool *const bm, PageFrame *p){
+    Metadata *meta = bm->mgmtData;
+    PageFile *f = getFile(meta, p->fileId);
+    long long start = STATS_NOW();
+    bool wasDirty = isDirty(meta, p);
+    long long since = p->dirtySince, lsn = p->dirtyLsn;
+
+    if(!f)
+        return RC_WRITE_FAILED;
+    setClean(meta, p);
+    lockIO(meta);
+    RC rc = writeBlock(p->frame.pageNum, &f->fh, p->frame.data);
+    unlockIO(meta);
+    if(rc != RC_OK){
+        if(wasDirty)
+            restoreDirty(meta, p, since, lsn);
+        return RC_WRITE_FAILED;
+    }
+    STATS_RECORD(meta, writeIO, start);
+    meta->numWrite++;
+
+    f->unsynced++;
+    if(meta->unsyncedWrites++ == 0 && meta->syncBatch > 0)
+        meta->firstUnsynced = nowNanos();
+    if(meta->syncBatch > 0 && (meta->unsyncedWrites >= meta->syncBatch
+                               || nowNanos() - meta->firstUnsynced >= meta->syncDelayNanos))
+        return syncAllFiles(meta);
+    return RC_OK;
+}
+/*
+ * Makes room in the frame for another page: writes the old one back if it's dirty
+ *  The (now clean) page goes into the compressed tier, if there is one.
+ */
+static RC evictFrame(BM_BufferPool *const bm, PageFrame *victim){
+    Metadata *meta = bm->mgmtData;
+
+    if(!isDirty(meta, victim)){
+        STATS_COUNT(meta, cleanEvictions);
+    } else {
+        STATS_COUNT(meta, dirtyEvictions);
+        if(writeFrame(bm, victim) != RC_OK)
+            return RC_WRITE_FAILED;
+    }
+    if(meta->tier && tierStore(meta->tier, victim->fileId, victim->frame.pageNum, victim->frame.data,
+                               victim->dataSize))
+        STATS_COUNT(meta, tierStores);
+    return RC_OK;
+}
+/*
+ * whether frame a is colder than frame b, ie ejected first: lower hint, then smaller heap key (the counter, or the
+ * K'th access for LRU_K), then lower index
+ */
+static bool colderFrame(const Metadata *meta, int a, int b){
+    if(meta->hints[a] != meta->hints[b])
+        return meta->hints[a] < meta->hints[b];
+    int ka = meta->heapKeys[(long) a * meta->heapKeyStride];
+    int kb = meta->heapKeys[(long) b * meta->heapKeyStride];
+
+    return ka < kb || (ka == kb && a < b);
+}
+/*
+ * the candidate heap: the frame at candidates[pos] moves up or down until the heap is in order again
+ */
+static void candidateSiftUp(Metadata *const meta, int pos){
+    int *heap = meta->candidates;
+    int f = heap[pos];
+
+    while(pos > 0){
+        int parent = (pos - 1) / 2;
+        if(!colderFrame(meta, f, heap[parent]))
+            break;
+        heap[pos] = heap[parent];
+        meta->frames[heap[pos]].candidatePos = pos;
+        pos = parent;
+    }
+    heap[pos] = f;
+    meta->frames[f].candidatePos = pos;
+}
+static void candidateSiftDown(Metadata *const meta, int pos){
+    int *heap = meta->candidates;
+    int f = heap[pos];
+
+    while(true){
+        int child = 2 * pos + 1;
+        if(child >= meta->numCandidates)
+            break;
+        if(child + 1 < meta->numCandidates && colderFrame(meta, heap[child + 1], heap[child]))
+            child++;
+        if(!colderFrame(meta, heap[child], f))
+            break;
+        heap[pos] = heap[child];
+        meta->frames[heap[pos]].candidatePos = pos;
+        pos = child;
+    }
+    heap[pos] = f;
+    meta->frames[f].candidatePos = pos;
+}
+/*
+ * the frame became evictable: it's resident and its fix count dropped to 0
+ */
+static void candidateInsert(BM_BufferPool *const bm, PageFrame *p){
+    Metadata *meta = bm->mgmtData;
+
+    if(!meta->heapKeys || p->candidatePos != -1) // CLOCK keeps no heap
+        return;
+    meta->candidates[meta->numCandidates] = (int) (p - meta->frames);
+    candidateSiftUp(meta, meta->numCandidates++);
+}
+/*
+ * the frame is no longer evictable: it was pinned, ejected or dropped
+ */
+static void candidateRemove(BM_BufferPool *const bm, PageFrame *p){
+    Metadata *meta = bm->mgmtData;
+    int pos = p->candidatePos;
+
+    if(pos == -1)
+        return;
+    p->candidatePos = -1;
+    if(pos == --meta->numCandidates)
+        return;
+    // the last frame takes its place and moves whichever way it belongs
+    int last = meta->candidates[meta->numCandidates];
+    meta->candidates[pos] = last;
+    candidateSiftUp(meta, pos);
+    if(meta->frames[last].candidatePos == pos)
+        candidateSiftDown(meta, pos);
+}
+/*
+ * rebuilds the candidate heap from the frames, ie after they were moved around
+ */
+static void rebuildCandidates(BM_BufferPool *const bm){
+    Metadata *meta = bm->mgmtData;
+
+    free(meta->candidates);
+    meta->candidates = malloc(sizeof(int) * bm->numPages);
+    meta->numCandidates = 0;
+    for(int i = 0; i < bm->numPages; i++)
+        meta->frames[i].candidatePos = -1;
+    for(int i = 0; i < bm->numPages; i++)
+        if(meta->frames[i].frame.pageNum != NO_PAGE && meta->fixCounts[i] == 0)
+            candidateInsert(bm, &meta->frames[i]);
+}
+/*
+ * tags frame i's page with a hint; a resident tag beyond the pool's resident share becomes a hot one
+ *  Only called while the frame is pinned, so it's never in the candidate heap when its order changes.
+ *  Returns whether the hint changed.
+ */
+static bool setHint(BM_BufferPool *const bm, int i, int hint){
+    Metadata *meta = bm->mgmtData;
+
+    if(hint == BM_HINT_RESIDENT && meta->hints[i] != BM_HINT_RESIDENT
+       && meta->numResident >= (long) bm->numPages * meta->residentShare / 100)
+        hint = BM_HINT_HOT;
+    if(hint == meta->hints[i])
+        return FALSE;
+    meta->numResident += (hint == BM_HINT_RESIDENT) - (meta->hints[i] == BM_HINT_RESIDENT);
+    meta->hints[i] = hint;
+    return TRUE;
+}
+/*
+ * frame i's page left the pool, so its hint goes with it
+ */
+static void clearHint(Metadata *const meta, int i){
+    if(meta->hints[i] == BM_HINT_RESIDENT)
+        meta->numResident--;
+    meta->hints[i] = BM_HINT_NORMAL;
+}
+/*
+ * RS_CUSTOM: tells the client's strategy about frame i's page leaving the pool, being unpinned, or its new hint
+ */
+static void customEvicted(Metadata *const meta, int i){
+    if(meta->custom && meta->custom->onEvict)
+        meta->custom->onEvict(meta->custom->state, i);
+}
+static void customHinted(Metadata *const meta, int i){
+    if(meta->custom && meta->custom->onHint)
+        meta->custom->onHint(meta->custom->state, i, meta->hints[i]);
+}
+static void customUnpinned(Metadata *const meta, int i){
+    if(meta->custom && meta->custom->onUnpin)
+        meta->custom->onUnpin(meta->custom->state, i, meta->fixCounts[i]);
+}
+/*
+ * Empties the frame without writing it back. The frame keeps its buffer for the next page.
+ */
+static void dropFrame(BM_BufferPool *const bm, PageFrame *p){
+    Metadata *meta = bm->mgmtData;
+
+    int i = frameIndex(meta, p);
+
+    candidateRemove(bm, p);
+    tableRemove(meta, i);
+    customEvicted(meta, i);
+    clearHint(meta, i);
+    pushFreeFrame(meta, p);
+    setClean(meta, p);
+    clearBit(meta->pinnedBits, i);
+    p->frame.pageNum = NO_PAGE;
+    meta->fixCounts[i] = 0;
+    meta->counters[i] = -1;
+    // optimistic readers of the old page have to retry
+    p->version += 2;
+}
+/*
+ * Writes all dirty pages in the buffer pool to disk
+ *  Pinned pages are written too (see writeFrame), so hot pages that are always pinned get flushed
+ *  Marks the disk'd pages clean again.
+ */
+RC forceFlushPool(BM_BufferPool *const bm){
+    Metadata *meta = bm->mgmtData;
+    PageFrame *pages = meta->frames;
+
+    // walk the dirty page table, oldest first, rather than every frame
+    for(int i = meta->dirtyHead; i != -1;){
+        int next = pages[i].dirtyNext; // writing takes the frame off the list
+        if(writeFrame(bm, &pages[i]) != RC_OK)
+            return RC_WRITE_FAILED;
+        i = next;
+    }
+    // the whole flush shares one sync per file
+    if(meta->syncBatch > 0)
+        return syncAllFiles(meta);
+    return RC_OK;
+}
+/*
+ * Finds a page given the fileId and pagenum: small pools scan the page number array, larger ones use the page table
+ */
+PageFrame* findPage(BM_BufferPool *const bm, int fileId, PageNumber pageNum){
+    Metadata *meta = bm->mgmtData;
+    unsigned int i = hashPage(fileId, pageNum) & meta->tableMask;
+    int f;
+
+    if(bm->numPages <= meta->scanThreshold){
+        if(pageNum == NO_PAGE)
+            return NULL;
+        f = meta->scanFrames(meta, (bm->numPages + 7) & ~7, fileId, pageNum);
+        return f >= 0 ? &meta->frames[f] : NULL;
+    }
+
+    while((f = meta->table[i]) != -1){
+        PageFrame *p = &meta->frames[f];
+        if(p->frame.pageNum == pageNum && p->fileId == fileId)
+            return p;
+        i = (i + 1) & meta->tableMask;
+    }
+    return NULL;
+}
+/*
+ * dumb max-heap implementation
+ *  history[0] is the newest access, history[K - 1] the K'th newest (0 if there were fewer than K)
+ */
+void updateLRU_K(Metadata *const meta, PageFrame *page, PageNumber counter){
+    int maxK = meta->lruK;
+    int *arr = historyOf(meta, frameIndex(meta, page));
+
+    // iterate from n ... 1
+    // move n - 1 to n
+    for(int i = maxK - 1; i > 0; i--)
+        arr[i] = arr[i - 1];
+    arr[0] = counter;
+}
+/*
+ * The unpinned frame FIFO/LRU/LFU/LRU_K would eject next, or NULL if every page is fixed
+ *  FIFO/LRU/LFU eject the smallest counter, LRU_K the oldest K'th access. Ties go to the lowest frame.
+ *  That's the top of the candidate heap. With a clean-first window W, a dirty coldest frame is passed over for the
+ *  coldest clean frame if that one is among the W coldest candidates, so the miss doesn't have to wait for a write.
+ */
+static PageFrame *chooseVictim(BM_BufferPool *const bm){
+    Metadata *meta = bm->mgmtData;
+    PageFrame *pages = meta->frames;
+    int *heap = meta->candidates;
+
+    if(meta->numCandidates == 0)
+        return NULL;
+    PageFrame *coldest = &pages[heap[0]];
+    if(meta->cleanFirstWindow <= 1 || !isDirty(meta, coldest))
+        return coldest;
+
+    // visit the W coldest candidates coldest first: a best-first walk down the heap, with a small heap of the
+    // positions it may visit next (the children of those it visited) as the frontier
+    int window = meta->cleanFirstWindow < meta->numCandidates ? meta->cleanFirstWindow : meta->numCandidates;
+    if(meta->frontierSize < window + 1){
+        free(meta->frontier);
+        meta->frontier = malloc(sizeof(int) * (window + 1));
+        meta->frontierSize = window + 1;
+    }
+    int *frontier = meta->frontier;
+    int n = 1;
+    frontier[0] = 0;
+    for(int visited = 0; visited < window && n > 0; visited++){
+        int pos = frontier[0];
+        if(!testBit(meta->dirtyBits, heap[pos]))
+            return &pages[heap[pos]];
+        // pop the visited position: the last one moves to the top and sifts down
+        frontier[0] = frontier[--n];
+        for(int i = 0;;){
+            int c = 2 * i + 1;
+            if(c >= n)
+                break;
+            if(c + 1 < n && colderFrame(meta, heap[frontier[c + 1]], heap[frontier[c]]))
+                c++;
+            if(!colderFrame(meta, heap[frontier[c]], heap[frontier[i]]))
+                break;
+            int t = frontier[c]; frontier[c] = frontier[i]; frontier[i] = t;
+            i = c;
+        }
+        // and its children join the frontier
+        for(int child = 2 * pos + 1; child <= 2 * pos + 2 && child < meta->numCandidates; child++){
+            int i = n++;
+            frontier[i] = child;
+            while(i > 0 && colderFrame(meta, heap[frontier[i]], heap[frontier[(i - 1) / 2]])){
+                int t = frontier[i]; frontier[i] = frontier[(i - 1) / 2]; frontier[(i - 1) / 2] = t;
+                i = (i - 1) / 2;
+            }
+        }
+    }
+    return coldest;
+}
+/*
+ * The frame the CLOCK hand ejects next, or NULL if every page is fixed
+ *  Moves the hand onto the returned frame.
+ *  With a clean-first window W, the hand passes over up to W dirty candidates looking for a clean one; if it finds
+ *  none it ejects the first dirty candidate it passed.
+ *  The reference counter is the page's hint (see touchCLOCK), and the hand takes one off per pass: a cold page goes
+ *  the first time the hand gets to it, a hot one survives a pass more than a normal one. Resident pages are passed
+ *  over until the hand has gone round often enough to know that nothing else can go.
+ */
+static PageFrame *clockVictim(BM_BufferPool *const bm){
+    Metadata *meta = (Metadata *) bm->mgmtData;
+    PageFrame *cur;
+    PageFrame *firstDirty = NULL;
+    int *counters = meta->counters;
+    int skipped = 0;
+
+    // from frames[cur] to frames[ejectable], we go through and count the counters down
+    // until we find a useable page.
+    int i = meta->curCounter % bm->numPages;
+    int start = i;
+    int fullruns = 0;
+    int residentRuns = BM_HINT_HOT + 1; // every other unpinned page is found within this many runs
+
+    while(true) {
+        cur = &meta->frames[i];
+        if(cur->frame.pageNum != NO_PAGE && (meta->hints[i] != BM_HINT_RESIDENT || fullruns >= residentRuns)){
+            if(meta->fixCounts[i] == 0 && counters[i] == 0){
+                if(!testBit(meta->dirtyBits, i) || meta->cleanFirstWindow == 0){
+                    meta->curCounter = i; // update the curPointer to the replaced page
+                    return cur;
+                }
+                // a dirty candidate keeps its reference bit clear, so it's still one when the window runs out
+                if(!firstDirty)
+                    firstDirty = cur;
+                if(++skipped >= meta->cleanFirstWindow)
+                    break;
+            }
+            if(counters[i] > 0)
+                counters[i]--;
+        }
+
+        i = (i + 1) % bm->numPages;
+        // we might do a full run for every step from the highest counter down to 0, first for the other pages,
+        // then for the resident ones. but if we do one more full run, then every page must be fixed > 0, which
+        // means we can't eject anything more.
+        if(i == start && ++fullruns >= residentRuns + BM_HINT_RESIDENT + 1)
+            break;
+    }
+
+    if(firstDirty)
+        meta->curCounter = (int) (firstDirty - meta->frames);
+    return firstDirty;
+}
+
+/*
+ * Replacement policies: each strategy's hit and load bookkeeping is a function of its own, so a pin makes one
+ * indirect call that does exactly its strategy's work instead of switching on bm->strategy every time.
+ *  FIFO only counts loads, LRU counts every pin, LFU counts how often, CLOCK sets the reference counter to the page's
+ *  hint (1 for a normal page, so a plain reference bit; and moves the hand to the page), LRU_K shifts the access
+ *  into the history.
+ */
+static void touchFIFO(Metadata *const meta, int i){
+}
+static void touchLRU(Metadata *const meta, int i){
+    meta->counters[i] = ++meta->curCounter;
+}
+static void touchLFU(Metadata *const meta, int i){
+    meta->counters[i]++;
+}
+static void touchCLOCK(Metadata *const meta, int i){
+    meta->counters[i] = meta->hints[i];
+    meta->curCounter = i;
+}
+static void touchLRU_K(Metadata *const meta, int i){
+    updateLRU_K(meta, &meta->frames[i], ++meta->curCounter);
+}
+/*
+ * a new page starts at the current counter (FIFO/LRU/LFU), with its reference counter at its hint (CLOCK), or with
+ * a history of just this access (LRU_K)
+ */
+static void admitCounter(Metadata *const meta, int i){
+    meta->counters[i] = meta->curCounter;
+}
+static void admitCLOCK(Metadata *const meta, int i){
+    meta->counters[i] = meta->hints[i];
+}
+static void admitLRU_K(Metadata *const meta, int i){
+    memset(historyOf(meta, i), 0, sizeof(int) * meta->lruK); // the history belonged to the previous page
+    updateLRU_K(meta, &meta->frames[i], meta->curCounter);
+}
+/*
+ * a frame was taken for a new page: FIFO/LRU/LRU_K give a page that replaces another the next counter value, CLOCK
+ * moves its hand onto a free frame (a victim is where the hand stopped already). LFU and RS_CUSTOM keep nothing here.
+ */
+static void takeNothing(Metadata *const meta, int i, bool wasFree){
+}
+static void takeCounter(Metadata *const meta, int i, bool wasFree){
+    if(!wasFree)
+        meta->curCounter++;
+}
+static void takeCLOCK(Metadata *const meta, int i, bool wasFree){
+    if(wasFree)
+        meta->curCounter = i;
+}
+/*
+ * RS_CUSTOM hands every event to the client's callbacks. The counter still tracks recency, so a warm state dump
+ * (see setWarmStateDump) has an order to go by.
+ */
+static void touchCustom(Metadata *const meta, int i){
+    meta->counters[i] = ++meta->curCounter;
+    if(meta->custom->onHit)
+        meta->custom->onHit(meta->custom->state, i);
+}
+static void admitCustom(Metadata *const meta, int i){
+    meta->counters[i] = ++meta->curCounter;
+    if(meta->custom->onLoad)
+        meta->custom->onLoad(meta->custom->state, i, meta->frames[i].fileId, meta->frames[i].frame.pageNum);
+}
+/*
+ * The frame the client's strategy picked, or NULL if it found none or picked one it can't have (free or pinned)
+ */
+static PageFrame *customVictim(BM_BufferPool *const bm){
+    Metadata *meta = bm->mgmtData;
+    int i = meta->custom->chooseVictim(meta->custom->state, meta->fixCounts, bm->numPages);
+
+    if(i < 0 || i >= bm->numPages || meta->frames[i].frame.pageNum == NO_PAGE || meta->fixCounts[i] > 0)
+        return NULL;
+    return &meta->frames[i];
+}
+static const ReplacementPolicy policies[RS_CUSTOM + 1] = {
+    [RS_FIFO]   = {touchFIFO,   admitCounter, takeCounter, chooseVictim, TRUE,  FALSE, TRUE},
+    [RS_LRU]    = {touchLRU,    admitCounter, takeCounter, chooseVictim, TRUE,  FALSE, TRUE},
+    [RS_CLOCK]  = {touchCLOCK,  admitCLOCK,   takeCLOCK,   clockVictim,  FALSE, TRUE,  FALSE},
+    [RS_LFU]    = {touchLFU,    admitCounter, takeNothing, chooseVictim, TRUE,  FALSE, FALSE},
+    [RS_LRU_K]  = {touchLRU_K,  admitLRU_K,   takeCounter, chooseVictim, TRUE,  FALSE, TRUE},
+    [RS_CUSTOM] = {touchCustom, admitCustom,  takeNothing, customVictim, FALSE, FALSE, FALSE},
+};
+
+// Buffer Manager Interface Pool Handling
+/*
+ * Grows or shrinks a running pool to newNumPages frames, keeping the warm cache
+ *  Growing just adds empty frames.
+ *  Shrinking ejects (and writes back, if dirty) as many unpinned pages as needed, in the order the replacement
+ *  strategy would eject them, then packs the remaining pages into the first newNumPages frames.
+ *  Resident pages keep their replacement state. Throws RC_BM_PAGE_PINNED, and changes nothing, if too many
+ *  pages are fixed to fit. If an RS_CUSTOM strategy finds no victim, the lowest unpinned frames are ejected instead.
+ *  Throws RC_WRITE_FAILED if a dirty victim can't be written back: the pool keeps its old size, and the pages
+ *  ejected before it stay ejected (they were clean or written back, so nothing is lost); the failed page stays
+ *  resident and dirty.
+ *  Optimistic reads of pages that were ejected or moved fail validation. The buffers of the frames that go away are
+ *  freed, or kept as spares while an optimistic read is open (see retireBuffer), so such a read never looks at
+ *  freed memory.
+ */
+RC resizeBufferPool(BM_BufferPool *const bm, const int newNumPages){
+    Metadata *meta = bm->mgmtData;
+    int oldNumPages = bm->numPages;
+    int resident;
+
+    if(newNumPages <= 0)
+        return RC_WRITE_FAILED;
+    drainAsyncPins(bm); // the reads write into frames that may move
+    resident = oldNumPages - meta->numFree;
+    if(countBits(meta->pinnedBits, oldNumPages) > newNumPages)
+        return RC_BM_PAGE_PINNED;
+
+    // eject the coldest pages until the rest fit. The check above leaves enough unpinned pages for that, but an
+    // RS_CUSTOM strategy may still find no victim; the shrink then takes the lowest unpinned frames rather than stop
+    // halfway
+    for(; resident > newNumPages; resident--){
+        PageFrame *victim = meta->policy->victim(bm);
+        for(int i = 0; !victim && i < oldNumPages; i++)
+            if(meta->frames[i].frame.pageNum != NO_PAGE && meta->fixCounts[i] == 0)
+                victim = &meta->frames[i];
+        if(!victim)
+            return RC_BM_PAGE_PINNED;
+        if(evictFrame(bm, victim) != RC_OK)
+            return RC_WRITE_FAILED;
+        dropFrame(bm, victim);
+    }
+
+    // the dirty page table links frames by index, so remember its order and relink it after packing
+    int *dirtyOrder = malloc(sizeof(int) * (oldNumPages > 0 ? oldNumPages : 1));
+    int numDirty = 0;
+    for(int i = meta->dirtyHead; i != -1; i = meta->frames[i].dirtyNext)
+        dirtyOrder[numDirty++] = i;
+    int *movedTo = malloc(sizeof(int) * oldNumPages);
+    for(int i = 0; i < oldNumPages; i++)
+        movedTo[i] = i;
+
+    // pack the pages of the frames that go away into the free frames that stay
+    int slot = 0;
+    for(int i = newNumPages; i < oldNumPages; i++){
+        PageFrame *from = &meta->frames[i];
+        if(from->frame.pageNum == NO_PAGE)
+            continue;
+        while(meta->frames[slot].frame.pageNum != NO_PAGE)
+            slot++;
+        PageFrame *to = &meta->frames[slot];
+        // the page keeps its buffer (the client may hold a pin on it), the free frame's buffer is retired
+        unsigned int version = (to->version > from->version ? to->version : from->version) + 2;
+        retireBuffer(meta, to->frame.data, to->dataSize);
+        *to = *from;
+        moveFrameState(meta, i, slot);
+        if(meta->custom && meta->custom->onMove)
+            meta->custom->onMove(meta->custom->state, i, slot);
+        to->version = version; // neither frame's optimistic readers may validate against the moved page
+        from->frame = (BM_PageHandle){NO_PAGE, NULL};
+        movedTo[i] = slot;
+        if(meta->policy->usesHand && meta->curCounter == i)
+            meta->curCounter = slot;
+    }
+    // optimistic reads of the frames that go away fail validation (their index is out of range), but may still be
+    // looking at the buffers
+    for(int i = newNumPages; i < oldNumPages; i++)
+        retireBuffer(meta, meta->frames[i].frame.data, meta->frames[i].dataSize);
+
+    meta->frames = realloc(meta->frames, sizeof(PageFrame) * newNumPages);
+    for(int i = oldNumPages; i < newNumPages; i++){
+        meta->frames[i].frame = (BM_PageHandle){NO_PAGE, NULL};
+        meta->frames[i].dataSize = 0;
+        meta->frames[i].fileId = BM_DEFAULT_FILE;
+        meta->frames[i].version = 0;
+        meta->frames[i].dirtyPrev = meta->frames[i].dirtyNext = -1;
+        meta->frames[i].candidatePos = -1;
+        meta->frames[i].reading = NULL;
+    }
+    resizeFrameState(meta, oldNumPages, newNumPages);
+    bm->numPages = newNumPages;
+    if(meta->policy->usesHand && meta->curCounter >= newNumPages)
+        meta->curCounter = 0;
+    rebuildTable(meta, newNumPages);
+    recountFrames(meta, newNumPages);
+    rebuildCandidates(bm);
+
+    meta->dirtyHead = meta->dirtyTail = -1;
+    for(int d = 0; d < numDirty; d++){
+        int i = movedTo[dirtyOrder[d]];
+        meta->frames[i].dirtyPrev = meta->dirtyTail;
+        meta->frames[i].dirtyNext = -1;
+        if(meta->dirtyTail != -1)
+            meta->frames[meta->dirtyTail].dirtyNext = i;
+        else
+            meta->dirtyHead = i;
+        meta->dirtyTail = i;
+    }
+    free(dirtyOrder);
+    free(movedTo);
+    return RC_OK;
+}
+/*
+ * Turns on group sync: every write (forcePage, forceFlushPool, a dirty eviction) is issued right away, and the
+ *  writes share fdatasyncs. A group is synced once it holds maxBatch writes or its oldest write is maxDelayMicros old
+ *  (checked on the next write, or by pollGroupSync). forceFlushPool and forceFlushFile end with a sync.
+ *  maxBatch 0, the default, turns it off; pages are then durable only once syncBufferPool is called.
+ */
+RC setGroupSync(BM_BufferPool *const bm, const int maxBatch, const int maxDelayMicros){
+    Metadata *meta = bm->mgmtData;
+
+    if(maxBatch < 0 || maxDelayMicros < 0)
+        return RC_WRITE_FAILED;
+    meta->syncBatch = maxBatch;
+    meta->syncDelayNanos = maxDelayMicros * 1000LL;
+    if(maxBatch > 0 && meta->unsyncedWrites > 0)
+        meta->firstUnsynced = nowNanos(); // writes from before count as issued now
+    return RC_OK;
+}
+/*
+ * Makes every page written so far durable, with one fdatasync per file that has unsynced writes
+ */
+RC syncBufferPool(BM_BufferPool *const bm){
+    return syncAllFiles(bm->mgmtData);
+}
+/*
+ * Syncs the current group if its oldest write is older than the max delay. For clients that stop writing for a
+ *  while: the delay is otherwise only checked when the next write comes in.
+ */
+RC pollGroupSync(BM_BufferPool *const bm){
+    Metadata *meta = bm->mgmtData;
+
+    if(meta->syncBatch > 0 && meta->unsyncedWrites > 0
+       && nowNanos() - meta->firstUnsynced >= meta->syncDelayNanos)
+        return syncAllFiles(meta);
+    return RC_OK;
+}
+/*
+ * Starts an incremental checkpoint: every page that is dirty now gets written within intervalMillis, oldest-dirtied
+ *  first, at a steady rate. The writes happen in checkpointStep, which the client calls regularly (ie between
+ *  requests). Pages dirtied after the start are left to the next checkpoint. Starting a checkpoint while another one
+ *  runs restarts it.
+ */
+RC beginCheckpoint(BM_BufferPool *const bm, const int intervalMillis){
+    Metadata *meta = bm->mgmtData;
+
+    if(intervalMillis < 0)
+        return RC_WRITE_FAILED;
+    meta->checkpointing = TRUE;
+    meta->checkpointLsn = meta->dirtyLsn;
+    meta->checkpointStart = nowNanos();
+    meta->checkpointNanos = intervalMillis * 1000000LL;
+    meta->checkpointTotal = meta->checkpointLeft = countBits(meta->dirtyBits, bm->numPages);
+    return RC_OK;
+}
+/*
+ * Writes the checkpoint's pages that are due by now: by time t into the interval, t/interval of them are written
+ *  Pages cleaned some other way (evictions, forcePage) count as written. Pinned pages are written too, like in
+ *  forceFlushPool. remaining is set to the number of checkpoint pages still dirty; at 0 the checkpoint is done (and synced,
+ *  if group sync is on).
+ */
+RC checkpointStep(BM_BufferPool *const bm, int *remaining){
+    Metadata *meta = bm->mgmtData;
+    PageFrame *pages = meta->frames;
+
+    if(!meta->checkpointing){
+        *remaining = 0;
+        return RC_OK;
+    }
+
+    long long elapsed = nowNanos() - meta->checkpointStart;
+    long long due = meta->checkpointTotal;
+    if(elapsed < meta->checkpointNanos)
+        due = (meta->checkpointTotal * elapsed + meta->checkpointNanos - 1) / meta->checkpointNanos;
+    long long toWrite = due - (meta->checkpointTotal - meta->checkpointLeft);
+
+    // the dirty list is ordered by dirtyLsn, so the checkpoint's pages are the ones at its head
+    for(int i = meta->dirtyHead; i != -1 && toWrite > 0 && pages[i].dirtyLsn <= meta->checkpointLsn;){
+        int next = pages[i].dirtyNext;
+        if(writeFrame(bm, &pages[i]) != RC_OK)
+            return RC_WRITE_FAILED;
+        toWrite--;
+        i = next;
+    }
+
+    *remaining = meta->checkpointLeft;
+    if(meta->checkpointLeft == 0){
+        meta->checkpointing = FALSE;
+        if(meta->syncBatch > 0)
+            return syncAllFiles(meta);
+    }
+    return RC_OK;
+}
+/*
+ * Puts a compressed victim tier of budgetBytes behind the pool: ejected pages are compressed into it, and misses
+ *  look there before reading the page file. 0 removes the tier. Changing the budget starts with an empty tier.
+ */
+RC setCompressedTier(BM_BufferPool *const bm, const long budgetBytes){
+    Metadata *meta = bm->mgmtData;
+
+    if(budgetBytes < 0)
+        return RC_WRITE_FAILED;
+    freeCompressedTier(meta->tier);
+    meta->tier = NULL;
+    if(budgetBytes == 0)
+        return RC_OK;
+    meta->tier = createCompressedTier(budgetBytes);
+    return meta->tier ? RC_OK : RC_WRITE_FAILED;
+}
+/*
+ * Pools of at most maxScanFrames frames find pages by scanning the frames' page numbers instead of probing the page
+ *  table. BM_SCAN_FRAMES is the default; 0 always uses the table.
+ */
+RC setLookupThreshold(BM_BufferPool *const bm, const int maxScanFrames){
+    Metadata *meta = bm->mgmtData;
+
+    if(maxScanFrames < 0)
+        return RC_WRITE_FAILED;
+    meta->scanThreshold = maxScanFrames;
+    return RC_OK;
+}
+/*
+ * Sets the clean-first window: a miss looks at the `window` coldest unpinned frames and ejects the coldest clean one
+ *  among them, only ejecting a dirty frame (and waiting for its write) if they're all dirty. 0, the default, turns it
+ *  off; 1 is the same as off.
+ */
+RC setCleanFirstWindow(BM_BufferPool *const bm, const int window){
+    Metadata *meta = bm->mgmtData;
+
+    if(window < 0)
+        return RC_WRITE_FAILED;
+    meta->cleanFirstWindow = window;
+    return RC_OK;
+}
+
+// Buffer Manager Interface Page Files
+/*
+ * Registers another page file with the pool, so its pages share the pool's frames
+ *  The file has to exist already. Its handle stays open until the file is unregistered or the pool shuts down.
+ *  Registering the same file name twice hands back the existing fileId.
+ */
+RC registerPageFile(BM_BufferPool *const bm, const char *const pageFileName, int *fileId){
+    Metadata *meta = bm->mgmtData;
+    int slot = -1;
+
+    drainAsyncPins(bm); // the file handles may move, and background reads hold on to them
+    for(int i = 0; i < meta->numFiles; i++){
+        if(!meta->files[i].fileName){
+            if(slot == -1)
+                slot = i;
+        } else if(strcmp(meta->files[i].fileName, pageFileName) == 0){
+            *fileId = i;
+            return RC_OK;
+        }
+    }
+    if(slot == -1){
+        slot = meta->numFiles;
+        meta->files = realloc(meta->files, sizeof(PageFile) * (meta->numFiles + 1));
+        meta->files[slot].fileName = NULL;
+        meta->numFiles++;
+    }
+
+    PageFile *f = &meta->files[slot];
+    char *name = strdup(pageFileName);
+    if(openPageFile(name, &f->fh) != RC_OK){
+        free(name);
+        return RC_FILE_NOT_FOUND;
+    }
+    f->fileName = name;
+    f->unsynced = 0;
+    *fileId = slot;
     return RC_OK;
 }
 /*
- * Writes all dirty pages in the buffer pool to disk
- *  Only write pages if fixcount = 0
- *  Marks the disk'd pages clean again.
- *  use forcePage
+ * Writes back the file's dirty pages, drops its pages from the pool and closes it
+ *  Throws an error if any of its pages are pinned. The pool's own pageFile (fileId 0) can't be unregistered.
  */
-RC forceFlushPool(BM_BufferPool *const bm){
+RC unregisterPageFile(BM_BufferPool *const bm, const int fileId){
+    Metadata *meta = bm->mgmtData;
+    PageFile *f = getFile(meta, fileId);
+    RC rc;
+
+    if(!f || fileId == BM_DEFAULT_FILE)
+        return RC_FILE_HANDLE_NOT_INIT;
+    drainAsyncPins(bm);
+    if((rc = forceFlushFile(bm, fileId)) != RC_OK)
+        return rc;
+    if((rc = invalidateFile(bm, fileId)) != RC_OK)
+        return rc;
+
+    meta->unsyncedWrites -= f->unsynced; // synced by the flush above if group sync is on
+    closePageFile(&f->fh);
+    free(f->fileName);
+    f->fileName = NULL;
+    return RC_OK;
+}
+/*
+ * the page size of a registered file, or -1 if there is no such file
+ */
+int getFilePageSize(BM_BufferPool *const bm, const int fileId){
+    PageFile *f = getFile(bm->mgmtData, fileId);
+    return f ? f->fh.pageSize : -1;
+}
+/*
+ * Writes all dirty pages of one file to disk, pinned ones included, like forceFlushPool
+ */
+RC forceFlushFile(BM_BufferPool *const bm, const int fileId){
     Metadata *meta = bm->mgmtData;
     PageFrame *pages = meta->frames;
 
-    for(int i = 0; i < bm->numPages; i++){
-        if (pages[i].fixcount == 0 && pages[i].dirty == TRUE){
-            if(forcePage(bm, &pages[i].frame) != RC_OK)
+    if(!getFile(meta, fileId))
+        return RC_FILE_HANDLE_NOT_INIT;
+    for(int i = meta->dirtyHead; i != -1;){
+        int next = pages[i].dirtyNext;
+        if(pages[i].fileId == fileId){
+            if(writeFrame(bm, &pages[i]) != RC_OK)
                 return RC_WRITE_FAILED;
-            pages[i].dirty = FALSE;
         }
+        i = next;
     }
+    if(meta->syncBatch > 0)
+        return syncFile(meta, getFile(meta, fileId));
     return RC_OK;
 }
 /*
- * Finds a page given the pagenum
- * ideally we'd have a hashmap or something, but for now its just a simple array
+ * Drops every page of the file from the pool WITHOUT writing it back (ie the table was dropped)
+ *  Throws an error, and drops nothing, if any of its pages are pinned.
  */
-PageFrame* findPage(BM_BufferPool *const bm, PageNumber pageNum){
+RC invalidateFile(BM_BufferPool *const bm, const int fileId){
     Metadata *meta = bm->mgmtData;
     PageFrame *pages = meta->frames;
 
+    if(!getFile(meta, fileId))
+        return RC_FILE_HANDLE_NOT_INIT;
     for(int i = 0; i < bm->numPages; i++)
-        if(pages[i].frame.pageNum == pageNum)
-            return &pages[i];
-    return NULL;
+        if(pages[i].frame.pageNum != NO_PAGE && pages[i].fileId == fileId && meta->fixCounts[i] > 0)
+            return RC_BM_PAGE_PINNED;
+    // backwards, so the lowest freed frame ends up on top of the free frame stack
+    for(int i = bm->numPages - 1; i >= 0; i--)
+        if(pages[i].frame.pageNum != NO_PAGE && pages[i].fileId == fileId)
+            dropFrame(bm, &pages[i]);
+    if(meta->tier)
+        tierDrop(meta->tier, fileId, NO_PAGE);
+    return RC_OK;
 }
 /*
- * dumb max-heap implementation
+ * Drops one page from the pool WITHOUT writing it back (ie a page of a temp table that was dropped)
+ *  Its frame goes straight back on the free frame stack. Nothing to do if the page isn't resident.
+ *  Throws RC_BM_PAGE_PINNED if the page is fixed.
  */
-void updateLRU_K(Metadata *const meta, PageFrame *page, PageNumber counter){
-    int maxK = meta->curCounter;
-    int *arr = page->accesses;
+RC invalidatePage(BM_BufferPool *const bm, const int fileId, const PageNumber pageNum){
+    Metadata *meta = bm->mgmtData;
 
-    // iterate from n ... 1
-    // move n - 1 to n
-    for(int i = maxK - 1; i > 1; i--)
-        arr[i] = arr[i - 1];
-    arr[0] = counter;
+    if(!getFile(meta, fileId))
+        return RC_FILE_HANDLE_NOT_INIT;
+    PageFrame *p = findPage(bm, fileId, pageNum);
+    if(p && testBit(meta->pinnedBits, frameIndex(meta, p)))
+        return RC_BM_PAGE_PINNED;
+    if(p)
+        dropFrame(bm, p);
+    if(meta->tier)
+        tierDrop(meta->tier, fileId, pageNum);
+    return RC_OK;
 }
 
 // Buffer Manager Interface Access Pages
@@ -149,10 +1666,24 @@ void updateLRU_K(Metadata *const meta, PageFrame *page, PageNumber counter){
  * marks the page as dirty
  */
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page){
-    PageFrame *p = findPage(bm, page->pageNum);
-    if(!p)
+    return markFileDirty(bm, BM_DEFAULT_FILE, page);
+}
+/*
+ * drops the page without writing it back, see invalidatePage
+ */
+RC discardPage (BM_BufferPool *const bm, BM_PageHandle *const page){
+    return invalidatePage(bm, BM_DEFAULT_FILE, page->pageNum);
+}
+RC markFileDirty (BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page){
+    Metadata *meta = bm->mgmtData;
+    PageFrame *p = findPage(bm, fileId, page->pageNum);
+    if(!p || p->reading) // a page still being read isn't the client's yet
         return RC_WRITE_FAILED;
-    p->dirty = TRUE;
+    if(meta->trace)
+        traceEvent(meta->trace, BM_TRACE_DIRTY, fileId, page->pageNum, 0);
+    setDirty(meta, p);
+    // the page was written to, so any optimistic reader has to retry
+    p->version += 2;
     return RC_OK;
 }
 /*
@@ -160,101 +1691,132 @@ RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page){
  *  use page->pagenum to figure out which page to unpin
  */
 RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page){
-    PageFrame *p = findPage(bm, page->pageNum);
-    if(!p || p->fixcount <= 0)
+    return unpinFilePage(bm, BM_DEFAULT_FILE, page);
+}
+RC unpinFilePage (BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page){
+    Metadata *meta = bm->mgmtData;
+    PageFrame *p = findPage(bm, fileId, page->pageNum);
+    int i = p ? frameIndex(meta, p) : -1;
+    if(!p || p->reading || meta->fixCounts[i] <= 0)
         return RC_WRITE_FAILED;
-    p->fixcount--;
+    if(meta->trace)
+        traceEvent(meta->trace, BM_TRACE_UNPIN, fileId, page->pageNum, 0);
+    if(--meta->fixCounts[i] == 0){
+        clearBit(meta->pinnedBits, i);
+        candidateInsert(bm, p);
+    }
+    customUnpinned(meta, i);
     return RC_OK;
 }
 /*
  * Writes the current page to disk
  */
 RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page){
+    return forceFilePage(bm, BM_DEFAULT_FILE, page);
+}
+RC forceFilePage (BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page){
     Metadata *meta = bm->mgmtData;
-    SM_FileHandle fh;
-    if(openPageFile(bm->pageFile, &fh) != RC_OK)
+    PageFrame *p = findPage(bm, fileId, page->pageNum);
+    if(!p || p->reading)
         return RC_WRITE_FAILED;
-    if(writeBlock(page->pageNum, &fh, page->data) != RC_OK)
-        return RC_WRITE_FAILED;
-
-    PageFrame *p = findPage(bm, page->pageNum);
-    if(!p)
-        return RC_WRITE_FAILED;
-    p->dirty = FALSE;
-
-    meta->numWrite++;
-    if(closePageFile(&fh) != RC_OK)
-        return RC_WRITE_FAILED;
-    return RC_OK;
+    if(meta->trace)
+        traceEvent(meta->trace, BM_TRACE_FORCE, fileId, page->pageNum, 0);
+    return writeFrame(bm, p);
 }
 
+/*
+ * Loads a page into the frame (a free one, or one whose old page was written back) and pins it once
+ *  With pending, a page that isn't in the compressed tier is read in the background instead: the frame goes into the
+ *  page table pinned right away, but its version stays odd until the read completes (see completeRead), and
+ *  RC_BM_PIN_PENDING is returned.
+ */
 RC setupNewPage(BM_BufferPool *bm,
                   PageFrame *frame,
+                  const int fileId,
                   BM_PageHandle *const page,
-                  const PageNumber pageNum
+                  const PageNumber pageNum,
+                  const int hint,
+                  PendingRead *pending
 ){
 
 
     Metadata *meta = bm->mgmtData;
-    meta->numRead++;
+    PageFile *f = getFile(meta, fileId);
+    if(!f)
+        return RC_FILE_HANDLE_NOT_INIT;
 
-    SM_FileHandle fh;
-    if (openPageFile(bm->pageFile, &fh) != RC_OK)
-        return RC_WRITE_FAILED;
-    if(frame->frame.data)
-        free(frame->frame.data); // wipe out the old data
-    page->data = (char *) malloc(PAGE_SIZE); // and in with the new
-    if (ensureCapacity(pageNum+1, &fh) != RC_OK)
-        return RC_WRITE_FAILED;  // in case the client just wants to write a new page
-    if (readBlock(pageNum, &fh, page->data) != RC_OK)
-        return RC_WRITE_FAILED;
-    if(closePageFile(&fh) != RC_OK)
-        return RC_WRITE_FAILED;
+    // the frame's buffer isn't freed while an optimistic read is open (see retireBuffer), so optimistic readers
+    // never touch freed memory. an odd version tells them the frame is in flux.
+    frame->version++;
+    bool wasFree = frame->frame.pageNum == NO_PAGE;
+    if(!wasFree){
+        candidateRemove(bm, frame);
+        tableRemove(meta, (int) (frame - meta->frames));
+        customEvicted(meta, (int) (frame - meta->frames));
+        clearHint(meta, (int) (frame - meta->frames));
+    }
+    setClean(meta, frame); // callers write the old page back first; this only keeps the counts straight
+    // pages of files with a different page size need a differently sized buffer; the old one is retired, an
+    // optimistic reader may still be looking at it
+    if(frame->frame.data && frame->dataSize != f->fh.pageSize){
+        retireBuffer(meta, frame->frame.data, frame->dataSize);
+        frame->frame.data = NULL;
+    }
+    if(!frame->frame.data){
+        frame->frame.data = takeBuffer(meta, f->fh.pageSize);
+        frame->dataSize = f->fh.pageSize;
+    }
+    frame->frame.pageNum = pageNum;
+    frame->fileId = fileId;
+    page->data = frame->frame.data;
+
+    RC rc = RC_OK;
+    long long start = STATS_NOW();
+    if (meta->tier && tierLoad(meta->tier, fileId, pageNum, page->data, f->fh.pageSize)) {
+        STATS_COUNT(meta, tierHits); // no I/O
+    } else {
+        meta->numRead++;
+        lockIO(meta);
+        if (ensureCapacity(pageNum+1, &f->fh) != RC_OK)
+            rc = RC_WRITE_FAILED;  // in case the client just wants to write a new page
+        else if (pending)
+            rc = RC_BM_PIN_PENDING; // submitted below, once the frame is set up
+        else if (readBlock(pageNum, &f->fh, page->data) != RC_OK)
+            rc = RC_WRITE_FAILED;
+        else
+            STATS_RECORD(meta, readIO, start);
+        unlockIO(meta);
+    }
+    bool failed = rc != RC_OK && rc != RC_BM_PIN_PENDING;
+    if(failed){
+        frame->frame.pageNum = NO_PAGE; // don't leave a half-read page behind
+        pushFreeFrame(meta, frame);     // a free frame was popped by the caller, so it goes back either way
+    } else
+        tableInsert(meta, (int) (frame - meta->frames));
+    if(rc != RC_BM_PIN_PENDING)
+        frame->version++;
+    if(failed)
+        return rc;
     page->pageNum = pageNum;
 
     // add the page to our buffer pool
-    frame->fixcount = 1;
-    frame->frame = *page;
-
-    if(bm->strategy == RS_CLOCK)
-        frame->counter = 1;
-    else if (bm->strategy == RS_LRU_K)
-        updateLRU_K(meta, frame, meta->curCounter);
-    else
-        frame->counter = meta->curCounter;
-    return RC_OK;
-}
-
-RC CLOCK(BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum){
-    Metadata *meta = (Metadata *) bm->mgmtData;
-    PageFrame *cur;
-
-    // from frames[cur] to frames[ejectable], we go through and set the counter to 0
-    // until we find a useable page.
-    int i = meta->curCounter;
-    int fullruns = 0;
-
-    while(true) {
-        cur = &meta->frames[i];
-        if(cur->fixcount == 0 && cur->counter == 0){
-            if(cur->dirty == TRUE)
-                forcePage(bm, &cur->frame);
-            setupNewPage(bm, cur, page, pageNum);
-            meta->curCounter = i; // update the curPointer to the replaced page
-            return RC_OK;
-        }
+    int i = frameIndex(meta, frame);
+    meta->fixCounts[i] = 1;
+    setBit(meta->pinnedBits, i);
 
-        cur->counter = 0;
+    bool hinted = setHint(bm, i, hint); // before admit, CLOCK weighs the reference by it
+    meta->policy->admit(meta, i);
+    if(hinted)
+        customHinted(meta, i);
 
-        i = (i + 1) % bm->numPages;
-        // we might do a full run if every page started with counter = 1, and got set to 0
-        // but if we do a second full run, then every page must be fixed > 0, which means we can't
-        // eject anything more.
-        if(i == meta->curCounter && ++fullruns >= 2)
-            break;
+    if(rc == RC_BM_PIN_PENDING){
+        pending->read = (AsyncRead){&f->fh, pageNum, frame->frame.data, RC_OK, 0, NULL};
+        pending->frame = i;
+        frame->reading = pending;
+        meta->inFlight++;
+        asyncSubmit(meta->reader, &pending->read);
     }
-
-    return RC_WRITE_FAILED;
+    return rc;
 }
 
 
@@ -266,94 +1828,593 @@ RC CLOCK(BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pa
  */
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page,
             const PageNumber pageNum){
+    return pinFilePage(bm, BM_DEFAULT_FILE, page, pageNum);
+}
+/*
+ * a frame for a page that isn't in the pool: a free one, or the replacement strategy's victim, written back first if
+ * it's dirty. NULL if every page is fixed or the write failed.
+ */
+static PageFrame *takeFrame(BM_BufferPool *const bm){
     Metadata *meta = bm->mgmtData;
-    PageFrame *pages = meta->frames;
-    PageFrame *minPage = &meta->frames[0];
+    PageFrame *empty = popFreeFrame(meta);
 
-    // realistically, this entire iteration should be skippable by a hashmap
-    // but it's too much work to implement.
+    // we don't have the page currently, but we have space for a new page
+    if(empty){
+        meta->policy->take(meta, frameIndex(meta, empty), TRUE);
+        return empty;
+    }
 
-    // first check if the page already exists in the pool
-    for(int i = 0; i < bm->numPages; i++){
-        // if we already have the page, we can just give it to the client.
-        if(pages[i].frame.pageNum == pageNum){
-            pages[i].fixcount++;
-            page->pageNum = pageNum;
-            page->data = pages[i].frame.data;
-            // The only place LRU is different from FIFO: It's counter is updated when re-pinned.
-            switch(bm->strategy){
-                case RS_LRU:   pages[i].counter = ++meta->curCounter; break;
-                case RS_LRU_K: updateLRU_K(meta, &pages[i], ++meta->curCounter); break;
-                case RS_LFU:   pages[i].counter++; break;
-                case RS_CLOCK:
-                    pages[i].counter = 1;
-                    meta->curCounter = i;
-                    break;
-                default: break;
-            }
-            return RC_OK;
-        }
+    // since we don't have a free page, we'll have to use the replacement strategy to find a new one
+    // CLOCK can't share the FIFO/LRU/LFU search, because it needs to set all that it passes through to 0
+    // when it wants to replace. Instead, it has its own circular list to work with.
+    long long waitStart = STATS_NOW();
+    PageFrame *victim = meta->policy->victim(bm);
+    if(!victim) // no page was unpinned; client error.
+        return NULL;
 
-        // we don't have the page currently, but we have space for a new page
-        if(pages[i].frame.data == NULL) {
-            setupNewPage(bm, &pages[i], page, pageNum);
-            if(bm->strategy == RS_CLOCK)
-                meta->curCounter = i;
-            return RC_OK;
+    meta->policy->take(meta, frameIndex(meta, victim), FALSE);
+
+    if(evictFrame(bm, victim) != RC_OK)
+        return NULL;
+    STATS_ADD(meta, pinWaitNanos, STATS_NOW() - waitStart);
+    return victim;
+}
+/*
+ * brings a page that isn't in the pool into a frame, pinned
+ */
+static RC loadPage(BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page,
+                   const PageNumber pageNum, const int hint){
+    PageFrame *frame = takeFrame(bm);
+
+    if(!frame)
+        return RC_WRITE_FAILED;
+    return setupNewPage(bm, frame, fileId, page, pageNum, hint, NULL);
+}
+/*
+ * pins the page in frame p, which holds it already: the hit half of a pin
+ */
+static void pinResident(BM_BufferPool *const bm, PageFrame *p, const int fileId, BM_PageHandle *const page,
+                        const int hint){
+    Metadata *meta = bm->mgmtData;
+    int i = frameIndex(meta, p);
+
+    // if we already have the page, we can just give it to the client.
+    if(meta->fixCounts[i]++ == 0){
+        setBit(meta->pinnedBits, i);
+        candidateRemove(bm, p);
+    }
+    page->pageNum = p->frame.pageNum;
+    page->data = p->frame.data;
+    if(hint != HINT_KEEP && setHint(bm, i, hint))
+        customHinted(meta, i);
+    // The only place LRU is different from FIFO: It's counter is updated when re-pinned.
+    meta->policy->touch(meta, i);
+    if(meta->trace)
+        traceEvent(meta->trace, BM_TRACE_PIN, fileId, p->frame.pageNum, BM_TRACE_HIT);
+    STATS_COUNT(meta, hits);
+}
+/*
+ * pinFilePage and pinFilePageWithHint; hint is HINT_KEEP for a plain pin
+ */
+static RC pinWithHint (BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page,
+                       const PageNumber pageNum, const int hint){
+    Metadata *meta = bm->mgmtData;
+
+    if(pageNum < 0 || !getFile(meta, fileId))
+        return RC_READ_NON_EXISTING_PAGE;
+
+    bool timed = STATS_SAMPLE_HIT(meta);
+    long long start = timed ? STATS_NOW() : 0;
+
+    // first check if the page already exists in the pool. If an asynchronous pin is still reading it, wait for that
+    // read instead of reading the page a second time.
+    PageFrame *p;
+    while((p = findPage(bm, fileId, pageNum)) && p->reading)
+        pollAsyncPins(bm, TRUE);
+    if(p){
+        pinResident(bm, p, fileId, page, hint);
+        if(timed)
+            STATS_RECORD(meta, pinHit, start);
+        return RC_OK;
+    }
+
+    if(!timed)
+        start = STATS_NOW();
+    RC rc = loadPage(bm, fileId, page, pageNum, hint == HINT_KEEP ? BM_HINT_NORMAL : hint);
+    if(meta->trace && rc == RC_OK)
+        traceEvent(meta->trace, BM_TRACE_PIN, fileId, pageNum, 0);
+    STATS_COUNT(meta, misses);
+    STATS_RECORD(meta, pinMiss, start);
+    return rc;
+}
+RC pinFilePage (BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page,
+                const PageNumber pageNum){
+    return pinWithHint(bm, fileId, page, pageNum, HINT_KEEP);
+}
+/*
+ * pins the page and tags it with a hint for the replacement strategy, see BM_PageHint
+ *  The page keeps the hint until it leaves the pool or is pinned with another one; pinPage leaves it alone.
+ *  Every strategy ejects cold pages first and hot pages last (CLOCK by giving them more passes of the hand), and
+ *  resident pages only when nothing else can go. Resident tags beyond setResidentShare percent of the frames
+ *  become hot ones.
+ */
+RC pinPageWithHint (BM_BufferPool *const bm, BM_PageHandle *const page, const PageNumber pageNum,
+                    const BM_PageHint hint){
+    return pinFilePageWithHint(bm, BM_DEFAULT_FILE, page, pageNum, hint);
+}
+RC pinFilePageWithHint (BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page,
+                        const PageNumber pageNum, const BM_PageHint hint){
+    if(hint < BM_HINT_COLD || hint > BM_HINT_RESIDENT)
+        return RC_WRITE_FAILED;
+    return pinWithHint(bm, fileId, page, pageNum, hint);
+}
+/*
+ * how many percent of the frames may hold pages pinned with BM_HINT_RESIDENT (BM_RESIDENT_SHARE by default)
+ *  Lowering it doesn't demote pages that are already resident; new resident tags become hot until they fit again.
+ */
+RC setResidentShare (BM_BufferPool *const bm, const int percent){
+    Metadata *meta = bm->mgmtData;
+
+    if(percent < 0 || percent > 100)
+        return RC_WRITE_FAILED;
+    meta->residentShare = percent;
+    return RC_OK;
+}
+
+// Buffer Manager Interface Asynchronous Pins
+/*
+ * Pins a page without waiting for the disk, for clients that run an event loop
+ *  If the page is in the pool (or the compressed tier), it's pinned right away: callback runs before pinPageAsync
+ *  returns RC_OK. Otherwise a frame is taken for it as for pinPage, a background thread reads the page, and
+ *  RC_BM_PIN_PENDING is returned; callback runs from pollAsyncPins once the read is done. A pin of a page whose read
+ *  is already out joins that read instead of starting another one. Either way the client unpins the page as usual,
+ *  once for every callback that got RC_OK.
+ *  Until its callback ran, the page isn't the client's: unpinning, dirtying or forcing it fails. pinPage on such a
+ *  page waits for the read.
+ *  A dirty victim is still written back before pinPageAsync returns. If no frame can be had (every page is fixed, or
+ *  the write failed) the error is returned and callback is never called.
+ */
+RC pinPageAsync (BM_BufferPool *const bm, const PageNumber pageNum, BM_PinCallback callback, void *ctx){
+    return pinFilePageAsync(bm, BM_DEFAULT_FILE, pageNum, callback, ctx);
+}
+RC pinFilePageAsync (BM_BufferPool *const bm, const int fileId, const PageNumber pageNum,
+                     BM_PinCallback callback, void *ctx){
+    Metadata *meta = bm->mgmtData;
+    BM_PageHandle page;
+    RC rc;
+
+    if(pageNum < 0 || !getFile(meta, fileId) || !callback)
+        return RC_READ_NON_EXISTING_PAGE;
+
+    PageFrame *p = findPage(bm, fileId, pageNum);
+    if(p && p->reading){
+        // one more pin and one more waiter on the read that's out
+        PinWaiter *w = malloc(sizeof(PinWaiter));
+        *w = (PinWaiter){callback, ctx, NULL};
+        *p->reading->lastWaiter = w;
+        p->reading->lastWaiter = &w->next;
+        pinResident(bm, p, fileId, &page, HINT_KEEP);
+        return RC_BM_PIN_PENDING;
+    }
+    if(p){
+        pinResident(bm, p, fileId, &page, HINT_KEEP);
+        callback(bm, &page, RC_OK, ctx);
+        return RC_OK;
+    }
+
+    if(!meta->reader && !(meta->reader = startAsyncReader())){
+        // no thread to read in the background, so the page is read right here
+        if((rc = pinWithHint(bm, fileId, &page, pageNum, HINT_KEEP)) != RC_OK)
+            return rc;
+        callback(bm, &page, RC_OK, ctx);
+        return RC_OK;
+    }
+
+    PageFrame *frame = takeFrame(bm);
+    if(!frame)
+        return RC_WRITE_FAILED;
+    PendingRead *pending = malloc(sizeof(PendingRead));
+    PinWaiter *w = malloc(sizeof(PinWaiter));
+    *w = (PinWaiter){callback, ctx, NULL};
+    pending->waiters = w;
+    pending->lastWaiter = &w->next;
+    rc = setupNewPage(bm, frame, fileId, &page, pageNum, BM_HINT_NORMAL, pending);
+    STATS_COUNT(meta, misses);
+    if(rc != RC_BM_PIN_PENDING){ // served by the compressed tier, or failed
+        free(w);
+        free(pending);
+    }
+    if(meta->trace && (rc == RC_OK || rc == RC_BM_PIN_PENDING))
+        traceEvent(meta->trace, BM_TRACE_PIN, fileId, pageNum, 0);
+    if(rc == RC_OK)
+        callback(bm, &page, RC_OK, ctx);
+    return rc;
+}
+/*
+ * Completes the background reads that are done, running their pins' callbacks on the calling thread
+ *  With wait, blocks until a read is done, unless none is out. Returns the number of callbacks that ran.
+ *  Every read is completed before any callback runs, so callbacks may call into the pool (ie unpin, pin again).
+ *  A failed read leaves no page behind; its callbacks get the error.
+ */
+int pollAsyncPins (BM_BufferPool *const bm, const bool wait){
+    Metadata *meta = bm->mgmtData;
+    int ran = 0;
+
+    if(!meta->reader || meta->inFlight == 0)
+        return 0;
+    AsyncRead *done = asyncCollect(meta->reader, wait);
+
+    // the frames first: the page is in, or it goes away again
+    for(AsyncRead *r = done; r; r = r->next){
+        PendingRead *pending = (PendingRead *) r;
+        PageFrame *p = &meta->frames[pending->frame];
+        p->reading = NULL;
+        meta->inFlight--;
+        p->version++;
+        if(r->rc == RC_OK)
+            STATS_RECORD_NANOS(meta, readIO, r->nanos);
+        else {
+            r->data = NULL;
+            dropFrame(bm, p); // drops the waiters' pins with the page
         }
+    }
+    // then the callbacks
+    while(done){
+        PendingRead *pending = (PendingRead *) done;
+        done = done->next;
+        for(PinWaiter *w = pending->waiters, *next; w; w = next){
+            BM_PageHandle page = {pending->read.pageNum, pending->read.data};
+            next = w->next;
+            w->callback(bm, &page, pending->read.rc == RC_OK ? RC_OK : RC_WRITE_FAILED, w->ctx);
+            free(w);
+            ran++;
+        }
+        free(pending);
+    }
+    return ran;
+}
+/*
+ * completes every background read that is out, ie before frames move or files close
+ */
+static void drainAsyncPins(BM_BufferPool *const bm){
+    Metadata *meta = bm->mgmtData;
+
+    while(meta->inFlight > 0)
+        pollAsyncPins(bm, TRUE);
+}
+/*
+ * a descriptor that is readable while finished reads wait for pollAsyncPins, so an event loop can poll it next to
+ *  its sockets (and then call pollAsyncPins without wait). Starts the background reader if no miss did yet.
+ *  -1 if the reader can't be started; asynchronous pins then complete right away.
+ */
+int getAsyncPinFd (BM_BufferPool *const bm){
+    Metadata *meta = bm->mgmtData;
+
+    if(!meta->reader)
+        meta->reader = startAsyncReader();
+    return meta->reader ? asyncEventFd(meta->reader) : -1;
+}
+
+// Buffer Manager Interface Tracing
+/*
+ * starts logging pin/unpin/markDirty/forcePage events to traceFile, a ring of the latest `capacity` events
+ *  a trace that is already running is closed first
+ */
+RC startTrace(BM_BufferPool *const bm, const char *const traceFile, const int capacity){
+    Metadata *meta = bm->mgmtData;
+
+    stopTrace(bm);
+    meta->trace = openTraceWriter(traceFile, capacity);
+    return meta->trace ? RC_OK : RC_WRITE_FAILED;
+}
+/*
+ * writes out the buffered events and closes the trace file
+ */
+RC stopTrace(BM_BufferPool *const bm){
+    Metadata *meta = bm->mgmtData;
+    RC rc = RC_OK;
+
+    if(meta->trace)
+        rc = closeTraceWriter(meta->trace);
+    meta->trace = NULL;
+    return rc;
+}
+
+// Buffer Manager Interface Warm State
+// The warm state of a page file is kept in a sidecar file next to it: "<pageFile>.warm".
+// It holds a magic number, the number of pages, then each page's number and hint, hottest page first. Sidecars
+// written before hints were kept hold just the page numbers, under WARM_STATE_MAGIC_V1; their pages come back normal.
+#define WARM_STATE_MAGIC 0x324d5742    // "BWM2"
+#define WARM_STATE_MAGIC_V1 0x534d5742 // "BWMS"
+
+static char *warmStateName(const char *fileName){
+    char *name = malloc(strlen(fileName) + 6);
+    sprintf(name, "%s.warm", fileName);
+    return name;
+}
+/*
+ * how much the replacement strategy wants to keep the frame; higher is hotter
+ */
+static long long frameHeat(BM_BufferPool *const bm, int i){
+    Metadata *meta = bm->mgmtData;
+
+    if(meta->lruK > 0){ // LRU_K: the K'th access decides, the newest one breaks ties
+        int *history = historyOf(meta, i);
+        return ((long long) history[meta->lruK - 1] << 32) + history[0];
+    }
+    return meta->counters[i];
+}
+
+// a frame and its heat, computed once before sorting so the comparison needs no pool
+typedef struct FrameHeat {
+    int hint;       // the page's hint ranks before its heat, as in the eviction order (see colderFrame)
+    long long heat;
+    int frame;
+} FrameHeat;
+
+static int compareHeat(const void *a, const void *b){
+    const FrameHeat *fa = a, *fb = b;
+    if(fa->hint != fb->hint)
+        return (fa->hint < fb->hint) - (fa->hint > fb->hint);
+    if(fa->heat != fb->heat)
+        return (fa->heat < fb->heat) - (fa->heat > fb->heat);
+    return (fa->frame > fb->frame) - (fa->frame < fb->frame);
+}
+
+static int compareWarmPage(const void *a, const void *b){
+    PageNumber pa = ((const WarmPage *) a)->pageNum, pb = ((const WarmPage *) b)->pageNum;
+    return (pa > pb) - (pa < pb);
+}
+/*
+ * Makes shutdownBufferPool dump the warm state of every registered file (or stop doing so)
+ */
+RC setWarmStateDump(BM_BufferPool *const bm, const bool enabled){
+    Metadata *meta = bm->mgmtData;
+    meta->dumpWarmState = enabled;
+    return RC_OK;
+}
+/*
+ * Writes the resident pages of every registered file, with their hints, to its sidecar, ordered by replacement
+ *  priority (the page the strategy would eject last comes first): resident and hot pages before normal ones, cold
+ *  ones last, and by the strategy's heat within each hint
+ */
+RC dumpPoolState(BM_BufferPool *const bm){
+    Metadata *meta = bm->mgmtData;
+    FrameHeat *order = malloc(sizeof(FrameHeat) * bm->numPages);
+    int *entries = malloc(sizeof(int) * 2 * bm->numPages); // page number and hint of each page
+    RC rc = RC_OK;
+
+    for(int fileId = 0; fileId < meta->numFiles && rc == RC_OK; fileId++){
+        PageFile *f = getFile(meta, fileId);
+        if(!f)
+            continue;
 
-        if(minPage->fixcount != 0)
-            minPage = &pages[i];
+        int n = 0;
+        for(int i = 0; i < bm->numPages; i++)
+            if(meta->frames[i].frame.pageNum != NO_PAGE && meta->frames[i].fileId == fileId)
+                order[n++] = (FrameHeat){meta->hints[i], frameHeat(bm, i), i};
+        qsort(order, n, sizeof(FrameHeat), compareHeat);
+        for(int i = 0; i < n; i++){
+            entries[2 * i] = meta->frames[order[i].frame].frame.pageNum;
+            entries[2 * i + 1] = order[i].hint;
+        }
 
-        // the FIFO/LRU/LFU page to replace
-        if (pages[i].fixcount == 0){
-            int maxK = meta->curCounter;
-            if (bm->strategy == RS_LRU_K && pages[i].accesses[maxK] < minPage->accesses[maxK])
-                minPage = &pages[i];
-            else if (pages[i].counter < minPage->counter)
-                minPage = &pages[i];
+        char *name = warmStateName(f->fileName);
+        FILE *fp = fopen(name, "wb");
+        int magic = WARM_STATE_MAGIC;
+        if(!fp)
+            rc = RC_WRITE_FAILED;
+        else {
+            if(fwrite(&magic, sizeof(int), 1, fp) != 1 || fwrite(&n, sizeof(int), 1, fp) != 1
+               || (int) fwrite(entries, 2 * sizeof(int), n, fp) != n)
+                rc = RC_WRITE_FAILED;
+            if(fclose(fp) != 0)
+                rc = RC_WRITE_FAILED;
         }
+        free(name);
     }
-    if(minPage->fixcount != 0) // no page was unpinned; client error.
-        return RC_WRITE_FAILED;
 
+    free(order);
+    free(entries);
+    return rc;
+}
+/*
+ * Loads the file's warm state back into the pool, batchSize pages per call
+ *  The first call reads the sidecar, keeps as many of the hottest pages as there are free frames, and sorts them by
+ *  page number so they are read in file order. Every call then loads the next batch into free frames; it never
+ *  ejects anything, and pages that are already resident are skipped. The client calls it from its idle loop
+ *  (ie right after initBufferPool) until *remaining drops to 0, so the pool warms up in the background of
+ *  regular pins.
+ *  Each page gets its hint back. Strategies that stamp pages with a counter (FIFO, LRU, LRU_K) get a range of it
+ *  reserved by the first call and hand it out by rank, so the prewarmed pages keep their order from the dump
+ *  whatever order they are read in, and rank above the pages that were resident before. CLOCK and LFU only get
+ *  the hints back; RS_CUSTOM sees the loads and hints through its callbacks.
+ *  Throws RC_FILE_NOT_FOUND if the file has no warm state.
+ */
+RC prewarmBufferPool(BM_BufferPool *const bm, const int fileId, const int batchSize, int *remaining){
+    Metadata *meta = bm->mgmtData;
+    PageFile *f = getFile(meta, fileId);
+    BM_PageHandle page;
+    int numFree = meta->numFree;
+    RC rc;
 
-    // now we're adding a new page, so FIFO/LIFO
-    if(bm->strategy == RS_FIFO || bm->strategy == RS_LRU || bm->strategy == RS_LRU_K)
-        meta->curCounter++; // we'll use the next value for new pages
+    if(!f)
+        return RC_FILE_HANDLE_NOT_INIT;
 
+    if(!meta->prewarmQueue || meta->prewarmFile != fileId){
+        char *name = warmStateName(f->fileName);
+        FILE *fp = fopen(name, "rb");
+        int magic = 0, n = 0, i;
+        free(name);
+        if(!fp)
+            return RC_FILE_NOT_FOUND;
+        if(fread(&magic, sizeof(int), 1, fp) != 1 || (magic != WARM_STATE_MAGIC && magic != WARM_STATE_MAGIC_V1)
+           || fread(&n, sizeof(int), 1, fp) != 1 || n < 0){
+            fclose(fp);
+            return RC_FILE_NOT_FOUND;
+        }
+        if(n > numFree)
+            n = numFree; // only the hottest pages fit
+        free(meta->prewarmQueue);
+        meta->prewarmQueue = malloc(sizeof(WarmPage) * (n + 1));
+        for(i = 0; i < n; i++){
+            WarmPage *w = &meta->prewarmQueue[i];
+            w->hint = BM_HINT_NORMAL;
+            if(fread(&w->pageNum, sizeof(PageNumber), 1, fp) != 1
+               || (magic == WARM_STATE_MAGIC && fread(&w->hint, sizeof(int), 1, fp) != 1))
+                break;
+            if(w->hint < BM_HINT_COLD || w->hint > BM_HINT_RESIDENT)
+                w->hint = BM_HINT_NORMAL;
+            w->rank = i;
+        }
+        n = i;
+        fclose(fp);
+        qsort(meta->prewarmQueue, n, sizeof(WarmPage), compareWarmPage);
+        meta->prewarmLen = n;
+        meta->prewarmPos = 0;
+        meta->prewarmFile = fileId;
+        if(meta->policy->stampsPages){
+            meta->prewarmStamp = meta->curCounter + n;
+            meta->curCounter += n + 1; // pages loaded later are newer than all of them
+        }
+    }
 
+    for(int loaded = 0; loaded < batchSize && meta->prewarmPos < meta->prewarmLen; ){
+        WarmPage *w = &meta->prewarmQueue[meta->prewarmPos++];
+        PageNumber pageNum = w->pageNum;
+        if(pageNum < 0 || pageNum >= f->fh.totalNumPages || findPage(bm, fileId, pageNum))
+            continue;
 
-    // since we don't have a free page, we'll have to use the replacement strategy to find a new one
-    switch(bm->strategy){
-
-        // FIFO/LRU/LFU/LRU_K set their counter's to the max of frame-list, so their logic for a new page is exactly the same
-        case RS_FIFO:
-        case RS_LRU:
-        case RS_LRU_K:
-        case RS_LFU:
-            if(minPage->dirty)
-                forcePage(bm, &minPage->frame);
-            if (setupNewPage(bm, minPage, page, pageNum) != RC_OK)
-                return RC_WRITE_FAILED;
-            break;
-        case RS_CLOCK:
-            // CLOCK can't be embedded in the above loop, because it needs to set all that it passes through to 1
-            // when it wants to replace. So if we embedded it above, it'd set it to 1 even if we already had the page.
-            // Instead, it has its own circular list to work with.
-            if (CLOCK(bm, page, pageNum) != RC_OK)
-                return RC_WRITE_FAILED;
+        PageFrame *frame = popFreeFrame(meta);
+        if(!frame){ // the client filled the pool in the meantime
+            meta->prewarmPos = meta->prewarmLen;
             break;
+        }
+        // admit stamps the page with its reserved counter value, the hottest page with the highest
+        int counter = meta->curCounter;
+        if(meta->policy->stampsPages)
+            meta->curCounter = meta->prewarmStamp - w->rank;
+        rc = setupNewPage(bm, frame, fileId, &page, pageNum, w->hint, NULL);
+        meta->curCounter = counter;
+        if(rc != RC_OK)
+            return RC_READ_NON_EXISTING_PAGE;
+        meta->fixCounts[frameIndex(meta, frame)] = 0;
+        clearBit(meta->pinnedBits, frameIndex(meta, frame));
+        candidateInsert(bm, frame);
+        customUnpinned(meta, frameIndex(meta, frame));
+        loaded++;
+    }
 
-        default:
-            break;
+    if(remaining)
+        *remaining = meta->prewarmLen - meta->prewarmPos;
+    if(meta->prewarmPos == meta->prewarmLen){
+        free(meta->prewarmQueue);
+        meta->prewarmQueue = NULL;
+        meta->prewarmLen = meta->prewarmPos = 0;
     }
+    return RC_OK;
+}
 
+// Optimistic Read Interface
+/*
+ * starts a read of the page without a pin
+ *  If the page is resident, page->data points at its frame and *version records the frame's sequence number.
+ *  No pin is taken and no replacement state is touched, so the client's own calls in between may evict the page or
+ *  modify it; the client has to call validateOptimisticRead once it is done looking at the data, as buffers that
+ *  frames give up are only freed once no read is open (see retireBuffer). The pool has no
+ *  latches, so only the thread that owns the pool may use it meanwhile (see buffer_mgr.h).
+ *  If the page isn't resident (or is currently being replaced), we fall back to pinPage and
+ *  return RC_BM_OPTIMISTIC_READ_FALLBACK; the client then holds a regular pin and must unpin it.
+ *  beginOptimisticFileRead does the same for a page of any registered file.
+ */
+RC beginOptimisticRead (BM_BufferPool *const bm, BM_PageHandle *const page,
+                        const PageNumber pageNum, BM_ReadVersion *version){
+    return beginOptimisticFileRead(bm, BM_DEFAULT_FILE, page, pageNum, version);
+}
+RC beginOptimisticFileRead (BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page,
+                            const PageNumber pageNum, BM_ReadVersion *version){
+    Metadata *meta = bm->mgmtData;
+    PageFrame *p = findPage(bm, fileId, pageNum);
 
-    return RC_OK;
+    version->fileId = fileId;
+    version->frameIndex = -1;
+    if(p){
+        unsigned int seq = p->version;
+        if(!(seq & 1) && p->frame.pageNum == pageNum){
+            page->pageNum = pageNum;
+            page->data = p->frame.data;
+            version->frameIndex = (int) (p - meta->frames);
+            version->seq = seq;
+            meta->numOptimisticReads++;
+            return RC_OK;
+        }
+    }
+
+    if(pinFilePage(bm, fileId, page, pageNum) != RC_OK)
+        return RC_WRITE_FAILED;
+    return RC_BM_OPTIMISTIC_READ_FALLBACK;
+}
+/*
+ * checks that nothing happened to the frame since beginOptimisticRead
+ *  RC_OK means the page wasn't ejected or marked dirty since, so everything read through page->data was consistent,
+ *  as long as the client marks the pages it modifies dirty before validating.
+ *  Otherwise the page was evicted or modified under us; we pin it and return RC_BM_OPTIMISTIC_READ_FALLBACK
+ *  so the client can redo its read against the pinned page (and unpin it afterwards).
+ */
+RC validateOptimisticRead (BM_BufferPool *const bm, BM_PageHandle *const page,
+                           const BM_ReadVersion version){
+    Metadata *meta = bm->mgmtData;
+
+    // the read is over, so once no other read is open nothing looks at the spare buffers any more
+    if(version.frameIndex >= 0 && meta->numOptimisticReads > 0 && --meta->numOptimisticReads == 0)
+        freeSpares(meta);
+
+    if(version.frameIndex >= 0 && version.frameIndex < bm->numPages
+       && meta->frames[version.frameIndex].version == version.seq)
+        return RC_OK;
+
+    if(pinFilePage(bm, version.fileId, page, page->pageNum) != RC_OK)
+        return RC_WRITE_FAILED;
+    return RC_BM_OPTIMISTIC_READ_FALLBACK;
 }
 
 // Statistics Interface
+/*
+ * fills the caller's arrays with the state of every frame, in one pass and without allocating anything
+ *  Arrays the caller doesn't need may be NULL. Throws RC_BM_SNAPSHOT_TOO_SMALL if capacity < bm->numPages.
+ */
+RC getPoolSnapshot (BM_BufferPool *const bm, BM_PoolSnapshot *snapshot){
+    Metadata *m = bm->mgmtData;
+    PageFrame *pages = m->frames;
+
+    if(snapshot->capacity < bm->numPages)
+        return RC_BM_SNAPSHOT_TOO_SMALL;
+    for(int i = 0; i < bm->numPages; i++){
+        if(snapshot->pageNums)
+            snapshot->pageNums[i] = pages[i].frame.pageNum;
+        if(snapshot->fileIds)
+            snapshot->fileIds[i] = pages[i].fileId;
+        if(snapshot->dirty)
+            snapshot->dirty[i] = testBit(m->dirtyBits, i);
+    }
+    if(snapshot->fixCounts)
+        memcpy(snapshot->fixCounts, m->fixCounts, sizeof(int) * bm->numPages);
+    snapshot->numPages = bm->numPages;
+    return RC_OK;
+}
+/*
+ * the number of free, pinned and dirty frames, without looking at any frame
+ *  pinned and dirty are popcounts over the bitsets, one word per 64 frames
+ */
+RC getPoolCounts (BM_BufferPool *const bm, BM_PoolCounts *counts){
+    Metadata *m = bm->mgmtData;
+    counts->numFree = m->numFree;
+    counts->numPinned = countBits(m->pinnedBits, bm->numPages);
+    counts->numDirty = countBits(m->dirtyBits, bm->numPages);
+    counts->oldestDirtyNanos = m->dirtyHead == -1 ? 0 : nowNanos() - m->frames[m->dirtyHead].dirtySince;
+    counts->bufferBytes = m->bufferBytes;
+    return RC_OK;
+}
 /*
  * returns an array of PageNumber
  *  i'th element is the pageNum of the i'th page stored in pageframe
@@ -378,10 +2439,9 @@ PageNumber *getFrameContents (BM_BufferPool *const bm){
 bool *getDirtyFlags (BM_BufferPool *const bm){
     bool *p = malloc(bm->numPages * sizeof(bool));
     Metadata *m = bm->mgmtData;
-    PageFrame *pages = m->frames;
 
     for(int i = 0; i < bm->numPages; i++){
-        p[i] = pages[i].dirty;
+        p[i] = testBit(m->dirtyBits, i);
     }
 
     return p;
@@ -394,13 +2454,28 @@ bool *getDirtyFlags (BM_BufferPool *const bm){
 int *getFixCounts (BM_BufferPool *const bm){
     int *p = malloc(bm->numPages * sizeof(int));
     Metadata *m = bm->mgmtData;
-    PageFrame *pages = m->frames;
 
-    for (int i=0; i<bm->numPages; i++)
-        p[i] = pages[i].fixcount;
+    memcpy(p, m->fixCounts, bm->numPages * sizeof(int));
 
     return p;
 }
+/*
+ * copies the pool's hot-path counters and latency histograms into *stats
+ *  all zero if the buffer manager was built with BM_NO_STATS
+ */
+RC getPoolStatistics (BM_BufferPool *const bm, BM_PoolStatistics *stats){
+    Metadata *meta = bm->mgmtData;
+    *stats = meta->stats;
+    return RC_OK;
+}
+/*
+ * starts the counters and histograms over (ie once a prewarm is done)
+ */
+RC resetPoolStatistics (BM_BufferPool *const bm){
+    Metadata *meta = bm->mgmtData;
+    memset(&meta->stats, 0, sizeof(BM_PoolStatistics));
+    return RC_OK;
+}
 /*
  * number of reads by buffer pool since initialization
  *  code should update counter whenever reading new page from disk
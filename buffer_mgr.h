@@ -13,13 +13,25 @@ typedef enum ReplacementStrategy {
 	RS_LRU = 1,
 	RS_CLOCK = 2,
 	RS_LFU = 3,
-	RS_LRU_K = 4
+	RS_LRU_K = 4,
+	RS_CUSTOM = 5     // stratData points to a BM_CustomStrategy
 } ReplacementStrategy;
 
+// how much a page is worth keeping, see pinPageWithHint. Unpinned pages are ejected in this order.
+typedef enum BM_PageHint {
+	BM_HINT_COLD = 0,      // ejected before any other page, ie pages of a scan
+	BM_HINT_NORMAL = 1,    // what pinPage gives a new page
+	BM_HINT_HOT = 2,       // ejected only once no cold or normal page is left (ie index inner pages)
+	BM_HINT_RESIDENT = 3   // kept while anything else can go, for up to setResidentShare percent of the frames
+} BM_PageHint;
+
 // Data Types and Structures
 typedef int PageNumber;
 #define NO_PAGE -1
 
+// the fileId of the page file the pool was initialized with
+#define BM_DEFAULT_FILE 0
+
 typedef struct BM_BufferPool {
 	char *pageFile;		// filename of the pagefile
 	int numPages;       // size of the buffer pool (number of frames)
@@ -33,6 +45,76 @@ typedef struct BM_PageHandle {
 	char *data;          // the data in the page
 } BM_PageHandle;
 
+// identifies the frame state an optimistic read started from, see beginOptimisticRead
+typedef struct BM_ReadVersion {
+	int fileId;         // the file the page belongs to, for the fallback pin
+	int frameIndex;     // the frame the page was found in, -1 if there was none
+	unsigned int seq;   // the frame's sequence counter at the start of the read
+} BM_ReadVersion;
+
+// log2-bucketed latency histogram: buckets[i] counts latencies in [2^i, 2^(i+1)) ns
+#define BM_HISTOGRAM_BUCKETS 32
+typedef struct BM_Histogram {
+	long long count;
+	long long totalNanos;
+	long long buckets[BM_HISTOGRAM_BUCKETS];
+} BM_Histogram;
+
+// hot-path counters of a pool, see getPoolStatistics
+typedef struct BM_PoolStatistics {
+	long long hits;             // pins that found their page in the pool
+	long long misses;           // pins that had to read their page
+	long long cleanEvictions;
+	long long dirtyEvictions;   // ejected pages that had to be written back first
+	long long pinWaitNanos;     // time missing pins spent waiting for a frame (victim search and write-back)
+	long long syncs;            // fdatasyncs, see setGroupSync
+	long long tierHits;         // misses served by the compressed tier instead of a read
+	long long tierStores;       // ejected pages put into the compressed tier
+	BM_Histogram pinHit;        // sampled, see buffer_mgr.c
+	BM_Histogram pinMiss;
+	BM_Histogram readIO;
+	BM_Histogram writeIO;
+	BM_Histogram syncIO;
+} BM_PoolStatistics;
+
+// state of every frame, filled in by getPoolSnapshot into arrays the caller owns
+typedef struct BM_PoolSnapshot {
+	int capacity;          // length of the arrays, set by the caller
+	int numPages;          // number of frames filled in
+	PageNumber *pageNums;  // any array may be NULL if the caller doesn't need it
+	int *fileIds;
+	bool *dirty;
+	int *fixCounts;
+} BM_PoolSnapshot;
+
+// aggregate frame counts, see getPoolCounts
+typedef struct BM_PoolCounts {
+	int numFree;
+	int numPinned;
+	int numDirty;
+	long long oldestDirtyNanos;  // how long the oldest dirty page has been dirty, 0 if none is
+	long long bufferBytes;       // page buffers the pool holds, spares kept for open optimistic reads included
+} BM_PoolCounts;
+
+// a replacement strategy written by the client, passed to initBufferPool as stratData with RS_CUSTOM
+// The pool keeps the page table, the I/O and the fix counts and tells the strategy what happens to each frame; the
+// strategy only decides which frame to eject. Every callback but chooseVictim may be NULL.
+typedef struct BM_CustomStrategy {
+	void *state;  // the strategy's own data, handed to every callback
+	void (*onLoad) (void *state, int frame, int fileId, PageNumber pageNum);  // a page was read into frame, pinned once
+	void (*onHit) (void *state, int frame);                // the page in frame was pinned again
+	void (*onUnpin) (void *state, int frame, int fixCount);  // the page was unpinned; fixCount is what's left
+	// the frame to eject: one holding a page, with fixCounts[frame] == 0. -1 if there is none
+	int (*chooseVictim) (void *state, const int *fixCounts, int numFrames);
+	void (*onEvict) (void *state, int frame);              // the frame's page left the pool
+	void (*onMove) (void *state, int from, int to);        // resizeBufferPool moved a page to another frame
+	void (*onHint) (void *state, int frame, BM_PageHint hint);  // a pin changed the page's hint, see pinPageWithHint
+} BM_CustomStrategy;
+
+// called once an asynchronous pin has its page, see pinPageAsync. With rc RC_OK the page is pinned and page holds
+// its number and data; otherwise the pin failed (page->data is NULL). page only lives for the call, so copy it out.
+typedef void (*BM_PinCallback) (BM_BufferPool *const bm, BM_PageHandle *const page, RC rc, void *ctx);
+
 // convenience macros
 #define MAKE_POOL()					\
 		((BM_BufferPool *) malloc (sizeof(BM_BufferPool)))
@@ -46,19 +128,86 @@ RC initBufferPool(BM_BufferPool *const bm, const char *const pageFileName,
 		void *stratData);
 RC shutdownBufferPool(BM_BufferPool *const bm);
 RC forceFlushPool(BM_BufferPool *const bm);
+RC resizeBufferPool(BM_BufferPool *const bm, const int newNumPages);
+RC setCleanFirstWindow(BM_BufferPool *const bm, const int window);
+RC setCompressedTier(BM_BufferPool *const bm, const long budgetBytes);
+RC setLookupThreshold(BM_BufferPool *const bm, const int maxScanFrames);
+
+// Buffer Manager Interface Durability
+RC setGroupSync(BM_BufferPool *const bm, const int maxBatch, const int maxDelayMicros);
+RC syncBufferPool(BM_BufferPool *const bm);
+RC pollGroupSync(BM_BufferPool *const bm);
+RC beginCheckpoint(BM_BufferPool *const bm, const int intervalMillis);
+RC checkpointStep(BM_BufferPool *const bm, int *remaining);
+
+// Buffer Manager Interface Warm State
+RC setWarmStateDump(BM_BufferPool *const bm, const bool enabled);
+RC dumpPoolState(BM_BufferPool *const bm);
+RC prewarmBufferPool(BM_BufferPool *const bm, const int fileId, const int batchSize,
+		int *remaining);
+
+// Buffer Manager Interface Tracing
+// see buffer_mgr_trace.h for the trace format and the analysis functions
+RC startTrace(BM_BufferPool *const bm, const char *const traceFile, const int capacity);
+RC stopTrace(BM_BufferPool *const bm);
 
 // Buffer Manager Interface Access Pages
 RC markDirty (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC unpinPage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC forcePage (BM_BufferPool *const bm, BM_PageHandle *const page);
+RC discardPage (BM_BufferPool *const bm, BM_PageHandle *const page);
 RC pinPage (BM_BufferPool *const bm, BM_PageHandle *const page, 
 		const PageNumber pageNum);
+RC pinPageWithHint (BM_BufferPool *const bm, BM_PageHandle *const page,
+		const PageNumber pageNum, const BM_PageHint hint);
+RC setResidentShare (BM_BufferPool *const bm, const int percent);
+
+// Buffer Manager Interface Asynchronous Pins
+RC pinPageAsync (BM_BufferPool *const bm, const PageNumber pageNum, BM_PinCallback callback, void *ctx);
+RC pinFilePageAsync (BM_BufferPool *const bm, const int fileId, const PageNumber pageNum,
+		BM_PinCallback callback, void *ctx);
+int pollAsyncPins (BM_BufferPool *const bm, const bool wait);
+int getAsyncPinFd (BM_BufferPool *const bm);
+
+// Buffer Manager Interface Page Files
+// A pool caches pages of any number of registered page files, keyed by (fileId, pageNum).
+// The functions above work on BM_DEFAULT_FILE.
+RC registerPageFile (BM_BufferPool *const bm, const char *const pageFileName, int *fileId);
+RC unregisterPageFile (BM_BufferPool *const bm, const int fileId);
+int getFilePageSize (BM_BufferPool *const bm, const int fileId);
+RC forceFlushFile (BM_BufferPool *const bm, const int fileId);
+RC invalidateFile (BM_BufferPool *const bm, const int fileId);
+RC invalidatePage (BM_BufferPool *const bm, const int fileId, const PageNumber pageNum);
+RC markFileDirty (BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page);
+RC unpinFilePage (BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page);
+RC forceFilePage (BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page);
+RC pinFilePage (BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page,
+		const PageNumber pageNum);
+RC pinFilePageWithHint (BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page,
+		const PageNumber pageNum, const BM_PageHint hint);
+
+// Buffer Manager Interface Optimistic Reads
+// Reads of a page without pinning it, for a client that glances at pages in between its other calls (ie an index
+// traversal that pins the child before it is done with the parent). Like the rest of the pool they are for the thread
+// that owns it: there is no latch, so another thread may not pin, unpin or modify pages meanwhile. Validation catches
+// evictions and markDirty, so a client that modifies a page has to mark it dirty before it validates a read that
+// overlaps the modification.
+RC beginOptimisticRead (BM_BufferPool *const bm, BM_PageHandle *const page,
+		const PageNumber pageNum, BM_ReadVersion *version);
+RC beginOptimisticFileRead (BM_BufferPool *const bm, const int fileId, BM_PageHandle *const page,
+		const PageNumber pageNum, BM_ReadVersion *version);
+RC validateOptimisticRead (BM_BufferPool *const bm, BM_PageHandle *const page,
+		const BM_ReadVersion version);
 
 // Statistics Interface
+RC getPoolSnapshot (BM_BufferPool *const bm, BM_PoolSnapshot *snapshot);
+RC getPoolCounts (BM_BufferPool *const bm, BM_PoolCounts *counts);
 PageNumber *getFrameContents (BM_BufferPool *const bm);
 bool *getDirtyFlags (BM_BufferPool *const bm);
 int *getFixCounts (BM_BufferPool *const bm);
 int getNumReadIO (BM_BufferPool *const bm);
 int getNumWriteIO (BM_BufferPool *const bm);
+RC getPoolStatistics (BM_BufferPool *const bm, BM_PoolStatistics *stats);
+RC resetPoolStatistics (BM_BufferPool *const bm);
 
 #endif
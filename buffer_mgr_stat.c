@@ -3,48 +3,45 @@
 
 // local functions
 static void printStrat(BM_BufferPool *const bm);
+static void takeSnapshot(BM_BufferPool *const bm, BM_PoolSnapshot *snap);
+static void printHistogram(const char *name, BM_Histogram *h);
+static long long histogramPercentile(BM_Histogram *h, double p);
 
 // external functions
 void
 printPoolContent(BM_BufferPool *const bm) {
-    PageNumber *frameContent;
-    bool *dirty;
-    int *fixCount;
+    BM_PoolSnapshot snap;
+    BM_PoolCounts counts;
     int i;
 
-    frameContent = getFrameContents(bm);
-    dirty = getDirtyFlags(bm);
-    fixCount = getFixCounts(bm);
+    takeSnapshot(bm, &snap);
+    getPoolCounts(bm, &counts);
 
     printf("{");
     printStrat(bm);
-    printf(" %i}: ", bm->numPages);
+    printf(" %i, %i free, %i pinned, %i dirty}: ", bm->numPages, counts.numFree, counts.numPinned, counts.numDirty);
 
-    for (i = 0; i < bm->numPages; i++)
-        printf("%s[%i%s%i]", ((i == 0) ? "" : ","), frameContent[i], (dirty[i] ? "x" : " "), fixCount[i]);
+    for (i = 0; i < snap.numPages; i++)
+        printf("%s[%i%s%i]", ((i == 0) ? "" : ","), snap.pageNums[i], (snap.dirty[i] ? "x" : " "), snap.fixCounts[i]);
     printf("\n");
+    free(snap.pageNums);
 }
 
 char *
 sprintPoolContent(BM_BufferPool *const bm) {
-    PageNumber *frameContent;
-    bool *dirty;
-    int *fixCount;
+    BM_PoolSnapshot snap;
     int i;
     char *message;
     int pos = 0;
 
     message = (char *) malloc(256 + (22 * bm->numPages));
-    frameContent = getFrameContents(bm);
-    dirty = getDirtyFlags(bm);
-    fixCount = getFixCounts(bm);
+    takeSnapshot(bm, &snap);
 
-    for (i = 0; i < bm->numPages; i++)
-        pos += sprintf(message + pos, "%s[%i%s%i]", ((i == 0) ? "" : ","), frameContent[i], (dirty[i] ? "x" : " "),
-                       fixCount[i]);
-    free(frameContent);
-    free(dirty);
-    free(fixCount);
+    for (i = 0; i < snap.numPages; i++)
+        pos += sprintf(message + pos, "%s[%i%s%i]", ((i == 0) ? "" : ","), snap.pageNums[i],
+                       (snap.dirty[i] ? "x" : " "), snap.fixCounts[i]);
+    message[pos] = '\0';
+    free(snap.pageNums);
 
     return message;
 }
@@ -52,29 +49,110 @@ sprintPoolContent(BM_BufferPool *const bm) {
 
 void
 printPageContent(BM_PageHandle *const page) {
+    printPageContentWithSize(page, PAGE_SIZE);
+}
+
+/*
+ * prints the page's pageSize bytes in hex, 8 to a group and 64 to a line
+ */
+void
+printPageContentWithSize(BM_PageHandle *const page, int pageSize) {
     int i;
 
     printf("[Page %i]\n", page->pageNum);
 
-    for (i = 1; i <= PAGE_SIZE; i++)
-        printf("%02X%s%s", page->data[i], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
+    for (i = 1; i <= pageSize; i++)
+        printf("%02X%s%s", (unsigned char) page->data[i - 1], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
 }
 
 char *
 sprintPageContent(BM_PageHandle *const page) {
+    return sprintPageContentWithSize(page, PAGE_SIZE);
+}
+
+char *
+sprintPageContentWithSize(BM_PageHandle *const page, int pageSize) {
     int i;
     char *message;
     int pos = 0;
 
-    message = (char *) malloc(30 + (2 * PAGE_SIZE) + (PAGE_SIZE % 64) + (PAGE_SIZE % 8));
+    // two digits a byte, a space after every 8 and a newline after every 64
+    message = (char *) malloc(30 + (2 * pageSize) + (pageSize / 64) + (pageSize / 8));
     pos += sprintf(message + pos, "[Page %i]\n", page->pageNum);
 
-    for (i = 1; i <= PAGE_SIZE; i++)
-        pos += sprintf(message + pos, "%02X%s%s", page->data[i], (i % 8) ? "" : " ", (i % 64) ? "" : "\n");
+    for (i = 1; i <= pageSize; i++)
+        pos += sprintf(message + pos, "%02X%s%s", (unsigned char) page->data[i - 1], (i % 8) ? "" : " ",
+                       (i % 64) ? "" : "\n");
 
     return message;
 }
 
+void
+printPoolStatistics(BM_BufferPool *const bm) {
+    BM_PoolStatistics stats;
+    long long pins;
+
+    getPoolStatistics(bm, &stats);
+    pins = stats.hits + stats.misses;
+
+    printf("{");
+    printStrat(bm);
+    printf(" %i}: ", bm->numPages);
+    printf("%lld hits, %lld misses (%.2f%% hit), %lld clean/%lld dirty evictions, %.1fus pin wait, %lld syncs\n",
+           stats.hits, stats.misses, pins ? 100.0 * stats.hits / pins : 0.0,
+           stats.cleanEvictions, stats.dirtyEvictions, stats.pinWaitNanos / 1000.0, stats.syncs);
+    if (stats.tierStores > 0)
+        printf("compressed tier: %lld stores, %lld hits\n", stats.tierStores, stats.tierHits);
+    printHistogram("pin hit", &stats.pinHit);
+    printHistogram("pin miss", &stats.pinMiss);
+    printHistogram("read I/O", &stats.readIO);
+    printHistogram("write I/O", &stats.writeIO);
+    printHistogram("sync", &stats.syncIO);
+}
+
+// upper bound of the bucket the p'th percentile falls into
+long long
+histogramPercentile(BM_Histogram *h, double p) {
+    long long rank = (long long) (p * h->count);
+    long long seen = 0;
+
+    if (rank >= h->count)
+        rank = h->count - 1;
+    int i;
+
+    for (i = 0; i < BM_HISTOGRAM_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen > rank)
+            break;
+    }
+    return 2LL << (i < BM_HISTOGRAM_BUCKETS ? i : BM_HISTOGRAM_BUCKETS - 1);
+}
+
+void
+printHistogram(const char *name, BM_Histogram *h) {
+    if (h->count == 0) {
+        printf("  %-9s: -\n", name);
+        return;
+    }
+    printf("  %-9s: n=%lld mean=%lldns p50<%lldns p99<%lldns max<%lldns\n", name, h->count,
+           h->totalNanos / h->count, histogramPercentile(h, 0.5), histogramPercentile(h, 0.99),
+           histogramPercentile(h, 1.0));
+}
+
+// snapshot of the whole pool in a single allocation; free snap->pageNums when done
+void
+takeSnapshot(BM_BufferPool *const bm, BM_PoolSnapshot *snap) {
+    int n = bm->numPages;
+    char *block = malloc(n * (sizeof(PageNumber) + sizeof(int) + sizeof(bool)));
+
+    snap->capacity = n;
+    snap->pageNums = (PageNumber *) block;
+    snap->fixCounts = (int *) (block + n * sizeof(PageNumber));
+    snap->dirty = (bool *) (block + n * (sizeof(PageNumber) + sizeof(int)));
+    snap->fileIds = NULL;
+    getPoolSnapshot(bm, snap);
+}
+
 void
 printStrat(BM_BufferPool *const bm) {
     switch (bm->strategy) {
@@ -93,6 +171,9 @@ printStrat(BM_BufferPool *const bm) {
         case RS_LRU_K:
             printf("LRU-K");
             break;
+        case RS_CUSTOM:
+            printf("CUSTOM");
+            break;
         default:
             printf("%i", bm->strategy);
             break;
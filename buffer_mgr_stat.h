@@ -8,5 +8,9 @@ void printPoolContent (BM_BufferPool *const bm);
 void printPageContent (BM_PageHandle *const page);
 char *sprintPoolContent (BM_BufferPool *const bm);
 char *sprintPageContent (BM_PageHandle *const page);
+// for pages that aren't PAGE_SIZE bytes: pageSize is the page's file's, see getFilePageSize
+void printPageContentWithSize (BM_PageHandle *const page, int pageSize);
+char *sprintPageContentWithSize (BM_PageHandle *const page, int pageSize);
+void printPoolStatistics (BM_BufferPool *const bm);
 
 #endif
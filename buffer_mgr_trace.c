@@ -0,0 +1,329 @@
+//
+// Access trace recording and analysis for the buffer manager.
+//
+#include "buffer_mgr_trace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// A trace file is a header followed by `capacity` record slots.
+// Record number i (counting from the start of the trace) lives in slot i % capacity.
+#define TRACE_MAGIC 0x52544d42 // "BMTR"
+#define TRACE_VERSION 1
+#define TRACE_BUFFER 512       // records collected in memory before they are written out
+
+typedef struct TraceHeader {
+    int magic;
+    int version;
+    int capacity;
+    int recordSize;
+    long long count;   // records written since the trace started
+} TraceHeader;
+
+struct BM_TraceWriter {
+    FILE *fp;
+    int capacity;
+    long long count;           // records written to the file
+    long long startNanos;
+    int buffered;
+    BM_TraceRecord buffer[TRACE_BUFFER];
+};
+
+static long long traceNanos(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static RC writeHeader(BM_TraceWriter *w) {
+    TraceHeader header = {TRACE_MAGIC, TRACE_VERSION, w->capacity, sizeof(BM_TraceRecord), w->count};
+
+    if (fseek(w->fp, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, w->fp) != 1)
+        return RC_WRITE_FAILED;
+    return RC_OK;
+}
+
+/*
+ * writes the buffered records into their ring slots, splitting the write where the ring wraps
+ */
+static RC flushTrace(BM_TraceWriter *w) {
+    int done = 0;
+
+    while (done < w->buffered) {
+        int slot = (int) (w->count % w->capacity);
+        int n = w->buffered - done;
+        if (n > w->capacity - slot)
+            n = w->capacity - slot;
+        if (fseek(w->fp, sizeof(TraceHeader) + (long) slot * sizeof(BM_TraceRecord), SEEK_SET) != 0
+            || fwrite(w->buffer + done, sizeof(BM_TraceRecord), n, w->fp) != n)
+            return RC_WRITE_FAILED;
+        w->count += n;
+        done += n;
+    }
+    w->buffered = 0;
+    return writeHeader(w);
+}
+
+/*
+ * creates (or truncates) the trace file, which keeps the last `capacity` events
+ */
+BM_TraceWriter *openTraceWriter(const char *const fileName, const int capacity) {
+    if (capacity <= 0)
+        return NULL;
+
+    BM_TraceWriter *w = malloc(sizeof(BM_TraceWriter));
+    w->fp = fopen(fileName, "wb");
+    if (!w->fp) {
+        free(w);
+        return NULL;
+    }
+    w->capacity = capacity;
+    w->count = 0;
+    w->buffered = 0;
+    w->startNanos = traceNanos();
+    if (writeHeader(w) != RC_OK) {
+        fclose(w->fp);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void traceEvent(BM_TraceWriter *w, const int op, const int fileId, const PageNumber pageNum, const int flags) {
+    BM_TraceRecord *r = &w->buffer[w->buffered++];
+
+    r->timestamp = traceNanos() - w->startNanos;
+    r->pageNum = pageNum;
+    r->fileId = (short) fileId;
+    r->op = (unsigned char) op;
+    r->flags = (unsigned char) flags;
+    if (w->buffered == TRACE_BUFFER)
+        flushTrace(w); // a failed trace write shouldn't fail the pin; the header just stays behind
+}
+
+RC closeTraceWriter(BM_TraceWriter *w) {
+    RC rc = flushTrace(w);
+
+    if (fclose(w->fp) != 0)
+        rc = RC_WRITE_FAILED;
+    free(w);
+    return rc;
+}
+
+/*
+ * reads every record still in the ring, oldest first
+ */
+RC readTrace(const char *const fileName, BM_TraceRecord **records, int *numRecords) {
+    FILE *fp = fopen(fileName, "rb");
+    TraceHeader header;
+
+    if (!fp)
+        return RC_FILE_NOT_FOUND;
+    if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != TRACE_MAGIC
+        || header.recordSize != sizeof(BM_TraceRecord) || header.capacity <= 0) {
+        fclose(fp);
+        return RC_FILE_NOT_FOUND;
+    }
+
+    int n = header.count < header.capacity ? (int) header.count : header.capacity;
+    int first = header.count < header.capacity ? 0 : (int) (header.count % header.capacity);
+    BM_TraceRecord *r = malloc(sizeof(BM_TraceRecord) * (n > 0 ? n : 1));
+
+    // the oldest record sits in slot `first`; everything before it wrapped around
+    if (fseek(fp, sizeof(TraceHeader) + (long) first * sizeof(BM_TraceRecord), SEEK_SET) != 0
+        || fread(r, sizeof(BM_TraceRecord), n - first, fp) != n - first
+        || fseek(fp, sizeof(TraceHeader), SEEK_SET) != 0
+        || fread(r + (n - first), sizeof(BM_TraceRecord), first, fp) != first) {
+        free(r);
+        fclose(fp);
+        return RC_READ_NON_EXISTING_PAGE;
+    }
+    fclose(fp);
+
+    *records = r;
+    *numRecords = n;
+    return RC_OK;
+}
+
+long long *tracePinReferences(const BM_TraceRecord *records, const int numRecords, int *numRefs) {
+    long long *refs = malloc(sizeof(long long) * (numRecords > 0 ? numRecords : 1));
+    int n = 0;
+
+    for (int i = 0; i < numRecords; i++)
+        if (records[i].op == BM_TRACE_PIN)
+            refs[n++] = ((long long) records[i].fileId << 32) | (unsigned int) records[i].pageNum;
+    *numRefs = n;
+    return refs;
+}
+
+// open addressing map from a reference to an int
+typedef struct RefMap {
+    long long *keys;
+    int *values;     // -1 if the slot is empty
+    unsigned int mask;
+} RefMap;
+
+static unsigned int hashReference(long long key) {
+    unsigned long long h = (unsigned long long) key * 0x9E3779B97F4A7C15ULL;
+    return (unsigned int) (h >> 32);
+}
+
+static void initRefMap(RefMap *m, int numRefs) {
+    unsigned int size = 16;
+
+    while (size < 2u * (unsigned int) numRefs)
+        size *= 2;
+    m->keys = malloc(sizeof(long long) * size);
+    m->values = malloc(sizeof(int) * size);
+    m->mask = size - 1;
+    memset(m->values, -1, sizeof(int) * size);
+}
+
+static void freeRefMap(RefMap *m) {
+    free(m->keys);
+    free(m->values);
+}
+
+/*
+ * the value slot of a reference; -1 if the reference is new
+ */
+static int *refMapSlot(RefMap *m, long long key) {
+    unsigned int i = hashReference(key) & m->mask;
+
+    while (m->values[i] != -1 && m->keys[i] != key)
+        i = (i + 1) & m->mask;
+    m->keys[i] = key;
+    return &m->values[i];
+}
+
+/*
+ * Bennett-Kruskal: a Fenwick tree marks the times that are the latest use of some page, so the number of distinct
+ * pages used since time t is the number of marks after t. O(n log n) for the whole trace.
+ */
+void lruStackDistances(const long long *refs, const int numRefs, int *distances) {
+    int *tree = calloc(numRefs + 1, sizeof(int));
+    RefMap last;
+    int marked = 0;
+
+    initRefMap(&last, numRefs);
+    for (int t = 0; t < numRefs; t++) {
+        int *prev = refMapSlot(&last, refs[t]);
+
+        if (*prev == -1)
+            distances[t] = 0;
+        else {
+            // marks up to and including the previous use
+            int before = 0;
+            for (int i = *prev + 1; i > 0; i -= i & -i)
+                before += tree[i];
+            distances[t] = marked - before + 1;
+            for (int i = *prev + 1; i <= numRefs; i += i & -i)
+                tree[i]--;
+            marked--;
+        }
+        for (int i = t + 1; i <= numRefs; i += i & -i)
+            tree[i]++;
+        marked++;
+        *prev = t;
+    }
+
+    free(tree);
+    freeRefMap(&last);
+}
+
+// max-heap entry of the OPT simulation: a resident page and the time of its next use
+typedef struct NextUse {
+    int time;
+    int page;
+} NextUse;
+
+static void heapPush(NextUse *heap, int *size, NextUse e) {
+    int i = (*size)++;
+
+    while (i > 0 && heap[(i - 1) / 2].time < e.time) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = e;
+}
+
+static NextUse heapPop(NextUse *heap, int *size) {
+    NextUse top = heap[0], e = heap[--(*size)];
+    int i = 0;
+
+    while (2 * i + 1 < *size) {
+        int c = 2 * i + 1;
+        if (c + 1 < *size && heap[c + 1].time > heap[c].time)
+            c++;
+        if (heap[c].time <= e.time)
+            break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = e;
+    return top;
+}
+
+/*
+ * Belady's MIN: on a miss with a full pool, evict the resident page whose next use lies furthest in the future.
+ *  Next uses are found with one backwards pass. The heap holds an entry per (page, next use) pair; entries whose page
+ *  was evicted or used again since are stale and skipped when they surface. O(n log n).
+ */
+long long optimalMisses(const long long *refs, const int numRefs, const int poolSize) {
+    int *page = malloc(sizeof(int) * (numRefs > 0 ? numRefs : 1));
+    int *next = malloc(sizeof(int) * (numRefs > 0 ? numRefs : 1));
+    RefMap ids;
+    int numPages = 0;
+
+    // dense page ids, so the rest can use plain arrays
+    initRefMap(&ids, numRefs);
+    for (int t = 0; t < numRefs; t++) {
+        int *id = refMapSlot(&ids, refs[t]);
+        if (*id == -1)
+            *id = numPages++;
+        page[t] = *id;
+    }
+    freeRefMap(&ids);
+
+    // next[t]: when page[t] is used again, numRefs if never
+    int *nextOf = malloc(sizeof(int) * (numPages > 0 ? numPages : 1));
+    for (int p = 0; p < numPages; p++)
+        nextOf[p] = numRefs;
+    for (int t = numRefs - 1; t >= 0; t--) {
+        next[t] = nextOf[page[t]];
+        nextOf[page[t]] = t;
+    }
+
+    // nextOf now holds the next use of each resident page, -1 for pages that aren't resident
+    for (int p = 0; p < numPages; p++)
+        nextOf[p] = -1;
+    NextUse *heap = malloc(sizeof(NextUse) * (numRefs > 0 ? numRefs : 1));
+    int heapSize = 0, resident = 0;
+    long long misses = 0;
+
+    for (int t = 0; t < numRefs && poolSize > 0; t++) {
+        int p = page[t];
+        if (nextOf[p] == -1) {
+            misses++;
+            if (resident == poolSize) {
+                NextUse victim;
+                do
+                    victim = heapPop(heap, &heapSize);
+                while (nextOf[victim.page] != victim.time);
+                nextOf[victim.page] = -1;
+                resident--;
+            }
+            resident++;
+        }
+        nextOf[p] = next[t];
+        heapPush(heap, &heapSize, (NextUse){next[t], p});
+    }
+    if (poolSize <= 0)
+        misses = numRefs;
+
+    free(heap);
+    free(nextOf);
+    free(next);
+    free(page);
+    return misses;
+}
@@ -0,0 +1,46 @@
+#ifndef BUFFER_MGR_TRACE_H
+#define BUFFER_MGR_TRACE_H
+
+#include "buffer_mgr.h"
+
+// Access traces
+// startTrace makes a pool log every pin/unpin/markDirty/forcePage into a ring file of fixed size records.
+// Once the ring is full the oldest records are overwritten, so the file always holds the latest `capacity` events.
+
+// event types
+#define BM_TRACE_PIN 1
+#define BM_TRACE_UNPIN 2
+#define BM_TRACE_DIRTY 3
+#define BM_TRACE_FORCE 4
+
+// event flags
+#define BM_TRACE_HIT 1   // a pin that found its page in the pool
+
+typedef struct BM_TraceRecord {
+	long long timestamp;     // nanoseconds since the trace started
+	PageNumber pageNum;
+	short fileId;
+	unsigned char op;        // BM_TRACE_*
+	unsigned char flags;
+} BM_TraceRecord;
+
+typedef struct BM_TraceWriter BM_TraceWriter;
+
+// writing traces (used by the buffer manager)
+BM_TraceWriter *openTraceWriter (const char *const fileName, const int capacity);
+void traceEvent (BM_TraceWriter *w, const int op, const int fileId, const PageNumber pageNum, const int flags);
+RC closeTraceWriter (BM_TraceWriter *w);
+
+// reading traces; the records come back oldest first and have to be freed by the caller
+RC readTrace (const char *const fileName, BM_TraceRecord **records, int *numRecords);
+
+// trace analysis
+// the pins of a trace as a reference string; a reference is (fileId << 32 | pageNum)
+long long *tracePinReferences (const BM_TraceRecord *records, const int numRecords, int *numRefs);
+// LRU stack distance of every reference: how many distinct pages were used since the page's last reference,
+// counting itself (so an LRU pool of C frames hits iff distance <= C); 0 for the first reference to a page
+void lruStackDistances (const long long *refs, const int numRefs, int *distances);
+// misses of Belady's optimal (MIN) replacement with poolSize frames: the least any strategy can do
+long long optimalMisses (const long long *refs, const int numRefs, const int poolSize);
+
+#endif
@@ -0,0 +1,261 @@
+//
+// Compressed victim tier: a byte-budgeted ring of compressed pages plus a hash index into it.
+//
+// Entries are appended at head and dropped at tail, so the arena needs no allocator: a page that is loaded back
+// into the pool just marks its entry dead, and the space is reclaimed when tail passes it. An entry that doesn't fit
+// before the end of the arena leaves a pad there and starts again at offset 0.
+//
+#include "compressed_tier.h"
+#include "page_compress.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ENTRY_LIVE 1
+#define ENTRY_DEAD 0
+#define ENTRY_PAD -1
+#define ALIGN8(n) (((n) + 7) & ~7L)
+
+typedef struct TierEntry {
+    int fileId;
+    PageNumber pageNum;
+    int compLen;   // == rawLen if the page didn't compress and is stored as is
+    int rawLen;
+    int state;     // ENTRY_*
+    int unused;
+} TierEntry;
+
+struct CompressedTier {
+    char *arena;
+    long budget;
+    long head;       // where the next entry goes
+    long tail;       // the oldest entry
+    long used;       // bytes between tail and head, pads included
+
+    // open addressing over entry offsets / 8, keyed by (fileId, pageNum)
+    int *index;      // -1 if the slot is empty
+    int indexMask;
+    int entries;     // live entries
+    long long pageBytes;
+
+    char *scratch;   // compression output
+};
+
+static TierEntry *entryAt(CompressedTier *t, long offset) {
+    return (TierEntry *) (t->arena + offset);
+}
+
+static long entrySize(TierEntry *e) {
+    return ALIGN8(sizeof(TierEntry) + e->compLen);
+}
+
+static unsigned int hashKey(int fileId, PageNumber pageNum) {
+    unsigned int h = (unsigned int) pageNum * 2654435761u;
+    h ^= (unsigned int) fileId * 2246822519u;
+    return h ^ (h >> 16);
+}
+
+static int findSlot(CompressedTier *t, int fileId, PageNumber pageNum) {
+    unsigned int i = hashKey(fileId, pageNum) & t->indexMask;
+
+    while (t->index[i] != -1) {
+        TierEntry *e = entryAt(t, t->index[i] * 8L);
+        if (e->fileId == fileId && e->pageNum == pageNum)
+            return (int) i;
+        i = (i + 1) & t->indexMask;
+    }
+    return -1;
+}
+
+/*
+ * linear probing delete with backward shift, like the pool's page table
+ */
+static void indexRemove(CompressedTier *t, int slot) {
+    unsigned int mask = t->indexMask;
+    unsigned int i = slot, j = slot;
+
+    while (1) {
+        j = (j + 1) & mask;
+        if (t->index[j] == -1)
+            break;
+        TierEntry *e = entryAt(t, t->index[j] * 8L);
+        unsigned int home = hashKey(e->fileId, e->pageNum) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            t->index[i] = t->index[j];
+            i = j;
+        }
+    }
+    t->index[i] = -1;
+}
+
+static void killEntry(CompressedTier *t, TierEntry *e) {
+    int slot = findSlot(t, e->fileId, e->pageNum);
+
+    if (slot >= 0)
+        indexRemove(t, slot);
+    e->state = ENTRY_DEAD;
+    t->entries--;
+    t->pageBytes -= e->rawLen;
+}
+
+/*
+ * drops the oldest entry (or the pad at the end of the arena)
+ */
+static void dropTail(CompressedTier *t) {
+    long rest = t->budget - t->tail;
+
+    if (rest < (long) sizeof(TierEntry) || entryAt(t, t->tail)->state == ENTRY_PAD) {
+        t->used -= rest;
+        t->tail = 0;
+    } else {
+        TierEntry *e = entryAt(t, t->tail);
+        if (e->state == ENTRY_LIVE)
+            killEntry(t, e);
+        t->used -= entrySize(e);
+        t->tail += entrySize(e);
+        if (t->tail == t->budget)
+            t->tail = 0;
+    }
+    if (t->used == 0)
+        t->head = t->tail = 0;
+}
+
+/*
+ * makes room for size contiguous bytes, dropping the oldest entries as needed; returns their offset
+ */
+static long reserve(CompressedTier *t, long size) {
+    while (1) {
+        if (t->used == 0)
+            t->head = t->tail = 0;
+        if (t->used == 0 || t->head > t->tail) {
+            // free space is [head, budget) and [0, tail)
+            if (size <= t->budget - t->head)
+                break;
+            long rest = t->budget - t->head;
+            if (rest >= (long) sizeof(TierEntry))
+                entryAt(t, t->head)->state = ENTRY_PAD;
+            t->used += rest;
+            t->head = 0;
+            continue;
+        }
+        // free space is [head, tail)
+        if (size <= t->tail - t->head)
+            break;
+        dropTail(t);
+    }
+    long offset = t->head;
+    t->head += size;
+    t->used += size;
+    return offset;
+}
+
+CompressedTier *createCompressedTier(const long budgetBytes) {
+    CompressedTier *t;
+    int indexSize = 16;
+    long budget = budgetBytes & ~7L;
+
+    if (budget < (long) sizeof(TierEntry) + MIN_PAGE_SIZE)
+        return NULL;
+    // room for an entry per 64 bytes of budget at half load; small compressed pages run out of index before arena
+    while (indexSize < 2 * (budget / 64) && indexSize < (1 << 30))
+        indexSize *= 2;
+
+    t = malloc(sizeof(CompressedTier));
+    t->arena = malloc(budget);
+    t->budget = budget;
+    t->head = t->tail = t->used = 0;
+    t->index = malloc(sizeof(int) * indexSize);
+    memset(t->index, -1, sizeof(int) * indexSize);
+    t->indexMask = indexSize - 1;
+    t->entries = 0;
+    t->pageBytes = 0;
+    t->scratch = malloc(COMPRESS_BOUND(MAX_PAGE_SIZE));
+    return t;
+}
+
+void freeCompressedTier(CompressedTier *tier) {
+    if (!tier)
+        return;
+    free(tier->arena);
+    free(tier->index);
+    free(tier->scratch);
+    free(tier);
+}
+
+bool tierStore(CompressedTier *t, const int fileId, const PageNumber pageNum, const char *data, const int size) {
+    // only keep the compressed form if it saves something
+    int compLen = compressPage(data, size, t->scratch, size - 1);
+    const char *payload = compLen < 0 ? data : t->scratch;
+    if (compLen < 0)
+        compLen = size;
+
+    long need = ALIGN8(sizeof(TierEntry) + compLen);
+    if (need > t->budget)
+        return FALSE;
+
+    tierDrop(t, fileId, pageNum); // a stale copy, if any
+    while (t->entries + 1 > (t->indexMask + 1) / 2)
+        dropTail(t);
+    long offset = reserve(t, need);
+    TierEntry *e = entryAt(t, offset);
+    e->fileId = fileId;
+    e->pageNum = pageNum;
+    e->compLen = compLen;
+    e->rawLen = size;
+    e->state = ENTRY_LIVE;
+    memcpy(e + 1, payload, compLen);
+
+    unsigned int i = hashKey(fileId, pageNum) & t->indexMask;
+    while (t->index[i] != -1)
+        i = (i + 1) & t->indexMask;
+    t->index[i] = (int) (offset / 8);
+    t->entries++;
+    t->pageBytes += size;
+    return TRUE;
+}
+
+bool tierLoad(CompressedTier *t, const int fileId, const PageNumber pageNum, char *data, const int size) {
+    int slot = findSlot(t, fileId, pageNum);
+    if (slot < 0)
+        return FALSE;
+
+    TierEntry *e = entryAt(t, t->index[slot] * 8L);
+    bool ok = e->rawLen == size;
+    if (ok && e->compLen == e->rawLen)
+        memcpy(data, e + 1, size);
+    else if (ok)
+        ok = decompressPage((const char *) (e + 1), e->compLen, data, size) == RC_OK;
+    killEntry(t, e); // the page is back in the pool (or the entry was no good)
+    return ok;
+}
+
+void tierDrop(CompressedTier *t, const int fileId, const PageNumber pageNum) {
+    if (pageNum != NO_PAGE) {
+        int slot = findSlot(t, fileId, pageNum);
+        if (slot >= 0)
+            killEntry(t, entryAt(t, t->index[slot] * 8L));
+        return;
+    }
+
+    // walk every entry from tail to head
+    long offset = t->tail, seen = 0;
+    while (seen < t->used) {
+        long rest = t->budget - offset;
+        if (rest < (long) sizeof(TierEntry) || entryAt(t, offset)->state == ENTRY_PAD) {
+            seen += rest;
+            offset = 0;
+            continue;
+        }
+        TierEntry *e = entryAt(t, offset);
+        if (e->state == ENTRY_LIVE && e->fileId == fileId)
+            killEntry(t, e);
+        seen += entrySize(e);
+        offset += entrySize(e);
+        if (offset == t->budget)
+            offset = 0;
+    }
+}
+
+void tierUsage(CompressedTier *t, long long *pageBytes, long long *arenaBytes) {
+    *pageBytes = t->pageBytes;
+    *arenaBytes = t->used;
+}
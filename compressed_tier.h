@@ -0,0 +1,25 @@
+#ifndef COMPRESSED_TIER_H
+#define COMPRESSED_TIER_H
+
+#include "buffer_mgr.h"
+
+// Compressed victim tier
+// A second cache level behind a buffer pool: pages ejected from the pool are compressed into a ring arena with a
+// fixed byte budget, and a miss looks there before reading the page file. When the arena is full the oldest pages
+// are dropped. The tier is exclusive: a page leaves it when it goes back into the pool.
+
+typedef struct CompressedTier CompressedTier;
+
+CompressedTier *createCompressedTier (const long budgetBytes);
+void freeCompressedTier (CompressedTier *tier);
+
+// stores a copy of a clean page; returns FALSE if it's too big for the budget
+bool tierStore (CompressedTier *tier, const int fileId, const PageNumber pageNum, const char *data, const int size);
+// moves the page out of the tier into data; returns FALSE if the tier doesn't have it
+bool tierLoad (CompressedTier *tier, const int fileId, const PageNumber pageNum, char *data, const int size);
+// forgets a page, or every page of a file if pageNum is NO_PAGE
+void tierDrop (CompressedTier *tier, const int fileId, const PageNumber pageNum);
+// bytes of page data the tier holds, and how many bytes of the arena that takes
+void tierUsage (CompressedTier *tier, long long *pageBytes, long long *arenaBytes);
+
+#endif
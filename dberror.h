@@ -4,7 +4,9 @@
 #include "stdio.h"
 
 /* module wide constants */
-#define PAGE_SIZE 4096
+#define PAGE_SIZE 4096          // the default page size of a new page file
+#define MIN_PAGE_SIZE 4096
+#define MAX_PAGE_SIZE 65536
 
 /* return code definitions */
 typedef int RC;
@@ -14,6 +16,13 @@ typedef int RC;
 #define RC_FILE_HANDLE_NOT_INIT 2
 #define RC_WRITE_FAILED 3
 #define RC_READ_NON_EXISTING_PAGE 4
+#define RC_INVALID_PAGE_SIZE 5
+#define RC_COMPRESSED_PAGE_CORRUPT 6
+
+#define RC_BM_OPTIMISTIC_READ_FALLBACK 100
+#define RC_BM_PAGE_PINNED 101
+#define RC_BM_SNAPSHOT_TOO_SMALL 102
+#define RC_BM_PIN_PENDING 103
 
 #define RC_RM_COMPARE_VALUE_OF_DIFFERENT_DATATYPE 200
 #define RC_RM_EXPR_RESULT_IS_NOT_BOOLEAN 201
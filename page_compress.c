@@ -0,0 +1,164 @@
+//
+// LZ77 page codec.
+//
+// The compressed stream is a series of sequences. Each sequence is
+//   token          high nibble: literal length, low nibble: match length - 4 (15 means more length bytes follow)
+//   [length bytes] 255 per byte until a byte below 255, added to the literal length
+//   literals
+//   offset         2 bytes, little endian, how far back the match starts
+//   [length bytes] the same for the match length
+// The last sequence only has literals and ends the stream.
+//
+#include "page_compress.h"
+#include <string.h>
+
+#define HASH_BITS 12
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+#define LAST_LITERALS 5  // the end of the input is always literals, so match search can read ahead safely
+
+static unsigned int read32(const unsigned char *p) {
+    unsigned int v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static unsigned int hashSequence(unsigned int seq) {
+    return (seq * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/*
+ * writes a length beyond the token's nibble as 255s and a final byte below 255
+ */
+static unsigned char *writeLength(unsigned char *op, int len) {
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (unsigned char) len;
+    return op;
+}
+
+int compressPage(const char *src, int srcLen, char *dst, int dstCap) {
+    const unsigned char *base = (const unsigned char *) src;
+    const unsigned char *ip = base, *anchor = base;
+    const unsigned char *end = base + srcLen;
+    const unsigned char *matchLimit = end - LAST_LITERALS;
+    unsigned char *op = (unsigned char *) dst;
+    unsigned char *oend = op + dstCap;
+    int table[1 << HASH_BITS];
+
+    if (srcLen < 0 || srcLen > MAX_PAGE_SIZE)
+        return -1;
+    memset(table, -1, sizeof(table));
+
+    while (srcLen > LAST_LITERALS + MIN_MATCH && ip + MIN_MATCH <= matchLimit) {
+        unsigned int seq = read32(ip);
+        unsigned int h = hashSequence(seq);
+        int cand = table[h];
+        table[h] = (int) (ip - base);
+        if (cand < 0 || ip - (base + cand) > MAX_OFFSET || read32(base + cand) != seq) {
+            ip++;
+            continue;
+        }
+
+        // extend the match, 8 bytes at a time while possible
+        const unsigned char *ref = base + cand;
+        const unsigned char *m = ip + MIN_MATCH, *r = ref + MIN_MATCH;
+        while (m + 8 <= matchLimit) {
+            unsigned long long a, b;
+            memcpy(&a, m, 8);
+            memcpy(&b, r, 8);
+            if (a != b) {
+                m += __builtin_ctzll(a ^ b) / 8;
+                break;
+            }
+            m += 8;
+            r += 8;
+        }
+        if (m + 8 > matchLimit)
+            while (m < matchLimit && *m == *r) {
+                m++;
+                r++;
+            }
+
+        int litLen = (int) (ip - anchor);
+        int matchLen = (int) (m - ip) - MIN_MATCH;
+        if (op + 1 + litLen / 255 + 1 + litLen + 2 + matchLen / 255 + 1 > oend)
+            return -1;
+        unsigned char *token = op++;
+        *token = (unsigned char) ((litLen < 15 ? litLen : 15) << 4);
+        if (litLen >= 15)
+            op = writeLength(op, litLen - 15);
+        memcpy(op, anchor, litLen);
+        op += litLen;
+        unsigned int offset = (unsigned int) (ip - ref);
+        *op++ = (unsigned char) (offset & 0xff);
+        *op++ = (unsigned char) (offset >> 8);
+        *token |= (unsigned char) (matchLen < 15 ? matchLen : 15);
+        if (matchLen >= 15)
+            op = writeLength(op, matchLen - 15);
+
+        ip = anchor = m;
+    }
+
+    // the last literals
+    int litLen = (int) (end - anchor);
+    if (op + 1 + litLen / 255 + 1 + litLen > oend)
+        return -1;
+    *op++ = (unsigned char) ((litLen < 15 ? litLen : 15) << 4);
+    if (litLen >= 15)
+        op = writeLength(op, litLen - 15);
+    memcpy(op, anchor, litLen);
+    op += litLen;
+    return (int) (op - (unsigned char *) dst);
+}
+
+/*
+ * reads a length continued past the token's nibble; -1 if the input ends first
+ */
+static int readLength(const unsigned char **ip, const unsigned char *iend, int len) {
+    if (len < 15)
+        return len;
+    while (*ip < iend) {
+        unsigned char b = *(*ip)++;
+        len += b;
+        if (b < 255)
+            return len;
+    }
+    return -1;
+}
+
+RC decompressPage(const char *src, int srcLen, char *dst, int dstLen) {
+    const unsigned char *ip = (const unsigned char *) src;
+    const unsigned char *iend = ip + srcLen;
+    unsigned char *op = (unsigned char *) dst;
+    unsigned char *oend = op + dstLen;
+
+    while (ip < iend) {
+        unsigned char token = *ip++;
+        int litLen = readLength(&ip, iend, token >> 4);
+        if (litLen < 0 || litLen > iend - ip || litLen > oend - op)
+            return RC_COMPRESSED_PAGE_CORRUPT;
+        memcpy(op, ip, litLen);
+        op += litLen;
+        ip += litLen;
+        if (ip == iend)
+            break; // the last sequence has no match
+
+        if (iend - ip < 2)
+            return RC_COMPRESSED_PAGE_CORRUPT;
+        int offset = ip[0] | (ip[1] << 8);
+        ip += 2;
+        int matchLen = readLength(&ip, iend, token & 15);
+        if (matchLen < 0 || offset == 0 || offset > op - (unsigned char *) dst)
+            return RC_COMPRESSED_PAGE_CORRUPT;
+        matchLen += MIN_MATCH;
+        if (matchLen > oend - op)
+            return RC_COMPRESSED_PAGE_CORRUPT;
+        // byte by byte: the match may overlap what it produces (ie a run of one byte has offset 1)
+        const unsigned char *ref = op - offset;
+        for (int i = 0; i < matchLen; i++)
+            op[i] = ref[i];
+        op += matchLen;
+    }
+    return op == oend ? RC_OK : RC_COMPRESSED_PAGE_CORRUPT;
+}
@@ -0,0 +1,18 @@
+#ifndef PAGE_COMPRESS_H
+#define PAGE_COMPRESS_H
+
+#include "dberror.h"
+
+// Page compression
+// A small LZ77 codec (LZ4-style block format) for page-sized buffers: no entropy coding, so it's cheap enough to run
+// on every eviction and every miss. Pages up to MAX_PAGE_SIZE bytes.
+
+// worst-case compressed size of srcLen bytes
+#define COMPRESS_BOUND(srcLen) ((srcLen) + (srcLen) / 255 + 16)
+
+// compresses srcLen bytes into dst; returns the compressed length, or -1 if it doesn't fit into dstCap bytes
+int compressPage (const char *src, int srcLen, char *dst, int dstCap);
+// decompresses srcLen bytes into exactly dstLen bytes of dst; RC_COMPRESSED_PAGE_CORRUPT if the input is damaged
+RC decompressPage (const char *src, int srcLen, char *dst, int dstLen);
+
+#endif
@@ -0,0 +1,305 @@
+//
+// Offline replay of a buffer manager access trace (see startTrace).
+//
+// First prints the LRU hit-ratio curve of the trace's pins, computed for every pool size at once from the LRU stack
+// distances, then replays the trace's pin/unpin/markDirty/forcePage events through real pools for every requested
+// strategy and pool size, next to the hit ratio of the optimal (MIN) replacement for that size.
+//
+// The traced pages are renumbered densely into one scratch page file, so a trace of a large database replays without
+// needing its files. The scratch file is sparse; only the pages the replay actually writes take up disk space.
+//
+// usage: replay_trace [-p poolSizes] [-s strategies] [-k K] [-c curvePoints] traceFile
+//   -p  comma separated pool sizes                              (default 10,100,1000)
+//   -s  comma separated strategies: fifo,lru,clock,lfu,lruk,all (default all)
+//   -k  K for LRU_K                                             (default 2)
+//   -c  pool sizes on the hit-ratio curve, 0 for no curve       (default 16)
+//
+#include "buffer_mgr.h"
+#include "buffer_mgr_trace.h"
+#include "storage_mgr.h"
+#include "dberror.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define REPLAY_FILE "replay_trace.bin"
+#define MAX_POOL_SIZES 16
+
+static const ReplacementStrategy strategies[] = {RS_FIFO, RS_LRU, RS_CLOCK, RS_LFU, RS_LRU_K};
+static const char *strategyNames[] = {"FIFO", "LRU", "CLOCK", "LFU", "LRU-K"};
+static const char *strategyArgs[] = {"fifo", "lru", "clock", "lfu", "lruk"};
+#define NUM_STRATEGIES ((int) (sizeof(strategies) / sizeof(strategies[0])))
+
+typedef struct ReplayConfig {
+    const char *traceFile;
+    int poolSizes[MAX_POOL_SIZES];
+    int numPoolSizes;
+    bool useStrategy[NUM_STRATEGIES];
+    int k;
+    int curvePoints;
+} ReplayConfig;
+
+// the traced events with every (fileId, pageNum) replaced by its dense page number
+typedef struct Replay {
+    const BM_TraceRecord *records;
+    PageNumber *pages;
+    int numRecords;
+    int numPages;
+} Replay;
+
+typedef struct ReplayResult {
+    int pins;
+    int hits;
+    int failed;   // pins the pool couldn't serve: everything was pinned
+    int reads;
+    int writes;
+} ReplayResult;
+
+static long long recordKey(const BM_TraceRecord *r) {
+    return ((long long) r->fileId << 32) | (unsigned int) r->pageNum;
+}
+
+static int compareKey(const void *a, const void *b) {
+    long long x = *(const long long *) a, y = *(const long long *) b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * numbers the distinct pages of the trace 0..numPages-1 in (fileId, pageNum) order
+ */
+static void densePages(Replay *replay, const BM_TraceRecord *records, int numRecords) {
+    long long *keys = malloc(sizeof(long long) * (numRecords > 0 ? numRecords : 1));
+    int n = 0;
+
+    for (int i = 0; i < numRecords; i++)
+        keys[i] = recordKey(&records[i]);
+    qsort(keys, numRecords, sizeof(long long), compareKey);
+    for (int i = 0; i < numRecords; i++)
+        if (n == 0 || keys[n - 1] != keys[i])
+            keys[n++] = keys[i];
+
+    replay->records = records;
+    replay->numRecords = numRecords;
+    replay->numPages = n;
+    replay->pages = malloc(sizeof(PageNumber) * (numRecords > 0 ? numRecords : 1));
+    for (int i = 0; i < numRecords; i++) {
+        long long key = recordKey(&records[i]);
+        long long *found = bsearch(&key, keys, n, sizeof(long long), compareKey);
+        replay->pages[i] = (PageNumber) (found - keys);
+    }
+    free(keys);
+}
+
+/*
+ * prints the LRU hit ratio for curvePoints pool sizes, spread geometrically up to the number of distinct pages
+ */
+static void printLruCurve(const BM_TraceRecord *records, int numRecords, int curvePoints) {
+    int numRefs;
+    long long *refs = tracePinReferences(records, numRecords, &numRefs);
+    int *distances = malloc(sizeof(int) * (numRefs > 0 ? numRefs : 1));
+    int maxDistance = 1;
+
+    lruStackDistances(refs, numRefs, distances);
+    // hitsAt[d] = references with stack distance d, then prefix sums: hits of an LRU pool of d frames
+    for (int i = 0; i < numRefs; i++)
+        if (distances[i] > maxDistance)
+            maxDistance = distances[i];
+    long long *hitsAt = calloc(maxDistance + 1, sizeof(long long));
+    for (int i = 0; i < numRefs; i++)
+        if (distances[i] > 0)
+            hitsAt[distances[i]]++;
+    for (int d = 1; d <= maxDistance; d++)
+        hitsAt[d] += hitsAt[d - 1];
+
+    printf("LRU hit-ratio curve (%d pins)\n", numRefs);
+    printf("%8s %8s\n", "pool", "hit%");
+    int last = 0;
+    for (int i = 1; i <= curvePoints && numRefs > 0; i++) {
+        // geometric steps from 1 to maxDistance, skipping sizes a rounding already printed
+        double frac = curvePoints > 1 ? (double) (i - 1) / (curvePoints - 1) : 1.0;
+        int size = (int) (0.5 + pow(maxDistance, frac));
+        if (size <= last)
+            continue;
+        last = size;
+        printf("%8d %8.2f\n", size, 100.0 * hitsAt[size] / numRefs);
+    }
+    printf("\n");
+
+    free(hitsAt);
+    free(distances);
+    free(refs);
+}
+
+/*
+ * feeds the trace's events through a fresh pool
+ *  unpins, dirties and forces of pages the replay doesn't hold pinned are skipped: their pin fell off the ring
+ */
+static RC replayOne(const ReplayConfig *cfg, const Replay *replay, ReplacementStrategy strategy, int poolSize,
+                    ReplayResult *result) {
+    BM_BufferPool bm;
+    BM_PageHandle h;
+    int *pinned = calloc(replay->numPages > 0 ? replay->numPages : 1, sizeof(int));
+    RC rc;
+
+    if ((rc = initBufferPool(&bm, REPLAY_FILE, poolSize, strategy, (void *) (long) cfg->k)) != RC_OK) {
+        free(pinned);
+        return rc;
+    }
+
+    memset(result, 0, sizeof(ReplayResult));
+    for (int i = 0; i < replay->numRecords; i++) {
+        PageNumber page = replay->pages[i];
+        h.pageNum = page;
+        switch (replay->records[i].op) {
+            case BM_TRACE_PIN:
+                result->pins++;
+                if (pinPage(&bm, &h, page) == RC_OK)
+                    pinned[page]++;
+                else
+                    result->failed++;
+                break;
+            case BM_TRACE_UNPIN:
+                if (pinned[page] > 0 && unpinPage(&bm, &h) == RC_OK)
+                    pinned[page]--;
+                break;
+            case BM_TRACE_DIRTY:
+                if (pinned[page] > 0)
+                    markDirty(&bm, &h);
+                break;
+            case BM_TRACE_FORCE:
+                if (pinned[page] > 0)
+                    forcePage(&bm, &h);
+                break;
+            default:
+                break;
+        }
+    }
+    // the trace may stop while pages are still pinned
+    for (PageNumber page = 0; page < replay->numPages; page++)
+        for (h.pageNum = page; pinned[page] > 0; pinned[page]--)
+            unpinPage(&bm, &h);
+
+    result->reads = getNumReadIO(&bm);
+    result->hits = result->pins - result->failed - result->reads; // every miss reads its page
+    result->writes = getNumWriteIO(&bm);
+    free(pinned);
+    return shutdownBufferPool(&bm);
+}
+
+/*
+ * a page file covering the dense page numbers; truncate() extends it without writing the pages
+ */
+static RC createReplayFile(int pages) {
+    RC rc;
+
+    if ((rc = createPageFile(REPLAY_FILE)) != RC_OK)
+        return rc;
+    if (truncate(REPLAY_FILE, (off_t) PAGE_SIZE * (pages + 1)) != 0) // page 0 of the file is its header
+        return RC_WRITE_FAILED;
+    return RC_OK;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-p poolSizes] [-s fifo,lru,clock,lfu,lruk|all] [-k K] [-c curvePoints] traceFile\n",
+            prog);
+    exit(1);
+}
+
+static void parseArgs(int argc, char **argv, ReplayConfig *cfg) {
+    cfg->traceFile = NULL;
+    cfg->poolSizes[0] = 10;
+    cfg->poolSizes[1] = 100;
+    cfg->poolSizes[2] = 1000;
+    cfg->numPoolSizes = 3;
+    for (int s = 0; s < NUM_STRATEGIES; s++)
+        cfg->useStrategy[s] = TRUE;
+    cfg->k = 2;
+    cfg->curvePoints = 16;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') {
+            if (cfg->traceFile)
+                usage(argv[0]);
+            cfg->traceFile = argv[i];
+            continue;
+        }
+        if (strlen(argv[i]) != 2 || i + 1 >= argc)
+            usage(argv[0]);
+        char *arg = argv[++i];
+        switch (argv[i - 1][1]) {
+            case 'k': cfg->k = atoi(arg); break;
+            case 'c': cfg->curvePoints = atoi(arg); break;
+            case 'p':
+                cfg->numPoolSizes = 0;
+                for (char *tok = strtok(arg, ","); tok && cfg->numPoolSizes < MAX_POOL_SIZES; tok = strtok(NULL, ","))
+                    cfg->poolSizes[cfg->numPoolSizes++] = atoi(tok);
+                break;
+            case 's':
+                if (strcmp(arg, "all") == 0)
+                    break;
+                for (int s = 0; s < NUM_STRATEGIES; s++)
+                    cfg->useStrategy[s] = FALSE;
+                for (char *tok = strtok(arg, ","); tok; tok = strtok(NULL, ",")) {
+                    int found = -1;
+                    for (int s = 0; s < NUM_STRATEGIES; s++)
+                        if (strcmp(tok, strategyArgs[s]) == 0)
+                            found = s;
+                    if (found < 0)
+                        usage(argv[0]);
+                    cfg->useStrategy[found] = TRUE;
+                }
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (!cfg->traceFile || cfg->numPoolSizes == 0 || cfg->k <= 0 || cfg->curvePoints < 0)
+        usage(argv[0]);
+}
+
+int
+main(int argc, char **argv) {
+    ReplayConfig cfg;
+    BM_TraceRecord *records;
+    int numRecords;
+    Replay replay;
+    ReplayResult r;
+
+    parseArgs(argc, argv, &cfg);
+    initStorageManager();
+    CHECK(readTrace(cfg.traceFile, &records, &numRecords));
+    densePages(&replay, records, numRecords);
+    printf("%s: %d events, %d distinct pages\n\n", cfg.traceFile, numRecords, replay.numPages);
+
+    if (cfg.curvePoints > 0)
+        printLruCurve(records, numRecords, cfg.curvePoints);
+
+    CHECK(createReplayFile(replay.numPages));
+    int numRefs;
+    long long *refs = tracePinReferences(records, numRecords, &numRefs);
+    printf("%6s %-6s %8s %8s %8s %8s %8s %8s\n", "pool", "strat", "pins", "hit%", "optGap", "reads", "writes",
+           "failed");
+    for (int p = 0; p < cfg.numPoolSizes; p++) {
+        // OPT only has a hit ratio; optGap is how many points of hit ratio a strategy loses to it
+        long long optMisses = optimalMisses(refs, numRefs, cfg.poolSizes[p]);
+        double optHit = numRefs > 0 ? 100.0 * (numRefs - optMisses) / numRefs : 0.0;
+        printf("%6d %-6s %8d %8.2f %8.2f %8lld\n", cfg.poolSizes[p], "OPT", numRefs, optHit, 0.0, optMisses);
+        for (int s = 0; s < NUM_STRATEGIES; s++) {
+            if (!cfg.useStrategy[s])
+                continue;
+            CHECK(replayOne(&cfg, &replay, strategies[s], cfg.poolSizes[p], &r));
+            double hit = r.pins > 0 ? 100.0 * r.hits / r.pins : 0.0;
+            printf("%6d %-6s %8d %8.2f %8.2f %8d %8d %8d\n", cfg.poolSizes[p], strategyNames[s], r.pins, hit,
+                   optHit - hit, r.reads, r.writes, r.failed);
+        }
+    }
+    free(refs);
+
+    CHECK(destroyPageFile(REPLAY_FILE));
+    free(replay.pages);
+    free(records);
+    return 0;
+}
@@ -0,0 +1,682 @@
+//
+// Shared buffer pool: a buffer pool in a POSIX shared memory segment, attached to by several processes.
+//
+// The segment is laid out as
+//   SharedHeader | SharedFrame[numPages] | page table, int[tableSize] | page data, numPages * pageSize, page aligned
+// and holds no pointers, since every process maps it at an address of its own: frames and table entries are indices.
+//
+// A frame being read in is marked `reading`: its page is in the table already, so another pin of it waits for the
+// read instead of reading the page a second time. A dirty page is written back from a private copy taken under the
+// latch, and its frame is marked `writing` until the write is done, so it can't be ejected (and its page read back
+// from the file by someone else) before the write has landed; a second write-back of the page waits for the first,
+// so an older copy never lands after a newer one.
+//
+// Both marks record the process doing the I/O. A process that dies mid I/O would leave its frame marked for good, so
+// whoever waits for the frame, and a CLOCK sweep that finds no victim, checks that the process is still alive and
+// clears the mark of a dead one. The header also keeps the pid of every attached process, so that processes that died
+// without detaching don't keep the last live one from removing the segment. Both checks use kill(pid, 0): the
+// processes have to share a pid namespace, and a pid reused in the meantime passes for the dead process.
+//
+#include "shared_pool.h"
+#include "storage_mgr.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SHARED_POOL_MAGIC 0x4c4f4f50 // "POOL"
+#define SHARED_NAME_LEN 256
+#define SHARED_ATTACH_MILLIS 2000    // how long attaching waits for the segment's creator to set it up
+#define SHARED_MAX_PROCS 64          // attachments at once
+#define SHARED_IO_POLL_MICROS 50     // how often a wait for another process's read or write looks at the frame
+#define ALIGN_TO(n, a) (((n) + (a) - 1) / (a) * (a))
+
+typedef struct SharedHeader {
+    int magic;             // SHARED_POOL_MAGIC once the creator has set the segment up
+    int closed;            // the last process detached and removed the segment; attach to a new one
+    int numPages;
+    int pageSize;
+    int tableMask;         // table size - 1; the size is a power of two
+    int attached;          // processes attached, the non-zero entries of procs
+    int clockHand;
+    int numRead;           // over every process
+    int numWrite;
+    long framesOffset;     // where the arrays start, from the start of the segment
+    long tableOffset;
+    long dataOffset;
+    char fileName[SHARED_NAME_LEN];
+    pthread_mutex_t latch; // process-shared and robust: guards everything but the page data
+    pid_t procs[SHARED_MAX_PROCS]; // the process of each attachment, 0 for a free slot
+} SharedHeader;
+
+typedef struct SharedFrame {
+    PageNumber pageNum;        // NO_PAGE if the frame is free
+    int fixCount;              // over every process
+    pid_t ioOwner;             // the process reading or writing the page, 0 if neither
+    unsigned char referenced;  // CLOCK's reference bit
+    unsigned char dirty;
+    unsigned char reading;     // the page is being read in, its data isn't there yet
+    unsigned char writing;     // the page is being written back
+} SharedFrame;
+
+// a process's view of the segment
+struct BM_SharedPool {
+    SharedHeader *hdr;
+    SharedFrame *frames;
+    int *table;            // -1 if the slot is empty
+    char *data;
+    size_t size;
+    char *shmName;
+    char *fileName;
+    SM_FileHandle fh;      // this process's own handle on the page file
+    char *shadow;          // private copy of a page being written back
+    int pins;              // pins this process holds
+    int slot;              // this attachment's entry in procs
+};
+
+static long long nowMillis(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000LL + t.tv_nsec / 1000000;
+}
+
+static void sleepBriefly(void) {
+    struct timespec t = {0, 1000000};
+    nanosleep(&t, NULL);
+}
+
+/*
+ * The latch is robust: a process that dies holding it doesn't hang the others, who take it over as it is (whatever
+ * the dead process was changing may be left half done, and its pins are never dropped). A process that dies while
+ * it reads or writes a page, without the latch, is handled by clearDeadIO.
+ */
+static void lockPool(SharedHeader *h) {
+    if (pthread_mutex_lock(&h->latch) == EOWNERDEAD)
+        pthread_mutex_consistent(&h->latch);
+}
+
+static void unlockPool(SharedHeader *h) {
+    pthread_mutex_unlock(&h->latch);
+}
+
+/*
+ * fills in the shape of a segment for numPages frames of pageSize bytes; returns its size
+ */
+static size_t segmentShape(SharedHeader *shape, int numPages, int pageSize) {
+    int tableSize = 16;
+    while (tableSize < 2 * numPages)
+        tableSize *= 2;
+
+    shape->numPages = numPages;
+    shape->pageSize = pageSize;
+    shape->tableMask = tableSize - 1;
+    shape->framesOffset = ALIGN_TO((long) sizeof(SharedHeader), 64);
+    shape->tableOffset = shape->framesOffset + (long) sizeof(SharedFrame) * numPages;
+    shape->dataOffset = ALIGN_TO(shape->tableOffset + (long) sizeof(int) * tableSize, 4096);
+    return shape->dataOffset + (size_t) numPages * pageSize;
+}
+
+static char *frameData(BM_SharedPool *pool, int i) {
+    return pool->data + (long) i * pool->hdr->pageSize;
+}
+
+static unsigned int hashPage(PageNumber pageNum) {
+    unsigned int h = (unsigned int) pageNum * 2654435761u;
+    return h ^ (h >> 16);
+}
+
+/*
+ * the page table: linear probing over frame indices with backward shift deletes, like the pool's
+ */
+static int tableFind(BM_SharedPool *pool, PageNumber pageNum) {
+    unsigned int mask = pool->hdr->tableMask;
+    unsigned int i = hashPage(pageNum) & mask;
+    int f;
+
+    while ((f = pool->table[i]) != -1) {
+        if (pool->frames[f].pageNum == pageNum)
+            return f;
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+static void tableInsert(BM_SharedPool *pool, int frame) {
+    unsigned int mask = pool->hdr->tableMask;
+    unsigned int i = hashPage(pool->frames[frame].pageNum) & mask;
+
+    while (pool->table[i] != -1)
+        i = (i + 1) & mask;
+    pool->table[i] = frame;
+}
+
+static void tableRemove(BM_SharedPool *pool, int frame) {
+    unsigned int mask = pool->hdr->tableMask;
+    unsigned int i = hashPage(pool->frames[frame].pageNum) & mask, j;
+
+    while (pool->table[i] != frame) {
+        if (pool->table[i] == -1)
+            return;
+        i = (i + 1) & mask;
+    }
+    j = i;
+    while (1) {
+        j = (j + 1) & mask;
+        if (pool->table[j] == -1)
+            break;
+        unsigned int home = hashPage(pool->frames[pool->table[j]].pageNum) & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            pool->table[i] = pool->table[j];
+            i = j;
+        }
+    }
+    pool->table[i] = -1;
+}
+
+/*
+ * 0 stands for a process that died holding the latch before it could record its pid
+ */
+static bool processAlive(pid_t pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+/*
+ * clears frame i's reading or writing mark if the process doing the I/O is dead; returns whether it did
+ *  Its read is dropped, frame and all, so the page is read again by whoever wants it next. Its write is taken as not
+ *  having landed: the page stays dirty.
+ */
+static bool clearDeadIO(BM_SharedPool *pool, int i) {
+    SharedFrame *f = &pool->frames[i];
+
+    if (!(f->reading || f->writing) || processAlive(f->ioOwner))
+        return FALSE;
+    if (f->reading) {
+        tableRemove(pool, i);
+        f->pageNum = NO_PAGE;
+        f->fixCount = 0;
+        f->referenced = 0;
+        f->reading = 0;
+    } else {
+        f->dirty = 1;
+        f->writing = 0;
+    }
+    f->ioOwner = 0;
+    return TRUE;
+}
+
+/*
+ * waits for another process's read or write of frame i to finish, letting go of the latch meanwhile
+ *  It polls instead of sleeping on a process-shared condition variable: a process killed while it waits on one leaves
+ *  the variable in a state that blocks the next broadcast for good. Every poll checks that the process doing the I/O
+ *  is still alive. Callers look at the frame again afterwards, it may still be busy.
+ */
+static void waitForIO(BM_SharedPool *pool, int i) {
+    struct timespec t = {0, SHARED_IO_POLL_MICROS * 1000L};
+
+    unlockPool(pool->hdr);
+    nanosleep(&t, NULL);
+    lockPool(pool->hdr);
+    clearDeadIO(pool, i);
+}
+
+/*
+ * forgets the attachments of processes that died without detaching
+ */
+static void clearDeadProcesses(SharedHeader *h) {
+    for (int i = 0; i < SHARED_MAX_PROCS; i++)
+        if (h->procs[i] != 0 && !processAlive(h->procs[i])) {
+            h->procs[i] = 0;
+            h->attached--;
+        }
+}
+
+/*
+ * the frame the CLOCK hand ejects next: a free one, or an unpinned one whose reference bit is clear. Frames that are
+ * being read or written are passed over. -1 if every frame is.
+ */
+static int clockSweep(BM_SharedPool *pool) {
+    SharedHeader *h = pool->hdr;
+
+    // the first round clears the reference bits it passes, so the second finds a frame if there is one
+    for (int step = 0; step < 2 * h->numPages; step++) {
+        int i = h->clockHand;
+        SharedFrame *f = &pool->frames[i];
+        h->clockHand = (i + 1) % h->numPages;
+        if (f->pageNum == NO_PAGE)
+            return i;
+        if (f->fixCount > 0 || f->reading || f->writing)
+            continue;
+        if (!f->referenced)
+            return i;
+        f->referenced = 0;
+    }
+    return -1;
+}
+
+/*
+ * like clockSweep, but if it finds no victim, frames left busy by dead processes are cleared and it sweeps again
+ */
+static int clockVictim(BM_SharedPool *pool) {
+    int i = clockSweep(pool);
+    bool cleared = FALSE;
+
+    if (i >= 0)
+        return i;
+    for (int j = 0; j < pool->hdr->numPages; j++)
+        cleared |= clearDeadIO(pool, j);
+    return cleared ? clockSweep(pool) : -1;
+}
+
+/*
+ * writes frame i's page back from a private copy, letting go of the latch for the write
+ *  The frame is clean from the copy on, so a change made during the write leaves it dirty again. The caller makes
+ *  sure the frame isn't being written already.
+ */
+static RC writeBack(BM_SharedPool *pool, int i) {
+    SharedHeader *h = pool->hdr;
+    SharedFrame *f = &pool->frames[i];
+    PageNumber pageNum = f->pageNum;
+    RC rc;
+
+    memcpy(pool->shadow, frameData(pool, i), h->pageSize);
+    f->dirty = 0;
+    f->writing = 1;
+    f->ioOwner = getpid();
+    unlockPool(h);
+    // another process may have grown the file; without the refresh writeBlock would append pages that exist
+    rc = refreshPageFile(&pool->fh);
+    if (rc == RC_OK)
+        rc = writeBlock(pageNum, &pool->fh, pool->shadow);
+    lockPool(h);
+    f->writing = 0;
+    f->ioOwner = 0;
+    if (rc != RC_OK) {
+        f->dirty = 1;
+        return RC_WRITE_FAILED;
+    }
+    h->numWrite++;
+    return RC_OK;
+}
+
+/*
+ * sets up a segment this process just created, and publishes it by setting the magic number last
+ */
+static void initSegment(SharedHeader *h, const SharedHeader *shape, const char *fileName) {
+    pthread_mutexattr_t latchAttr;
+
+    h->closed = 0;
+    h->numPages = shape->numPages;
+    h->pageSize = shape->pageSize;
+    h->tableMask = shape->tableMask;
+    h->framesOffset = shape->framesOffset;
+    h->tableOffset = shape->tableOffset;
+    h->dataOffset = shape->dataOffset;
+    h->attached = 0;
+    memset(h->procs, 0, sizeof(h->procs));
+    h->clockHand = 0;
+    h->numRead = h->numWrite = 0;
+    strcpy(h->fileName, fileName);
+
+    SharedFrame *frames = (SharedFrame *) ((char *) h + h->framesOffset);
+    for (int i = 0; i < h->numPages; i++)
+        frames[i] = (SharedFrame) {NO_PAGE, 0, 0, 0, 0, 0, 0};
+    memset((char *) h + h->tableOffset, -1, sizeof(int) * (h->tableMask + 1));
+
+    pthread_mutexattr_init(&latchAttr);
+    pthread_mutexattr_setpshared(&latchAttr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&latchAttr, PTHREAD_MUTEX_ROBUST);
+    pthread_mutex_init(&h->latch, &latchAttr);
+    pthread_mutexattr_destroy(&latchAttr);
+
+    __atomic_store_n(&h->magic, SHARED_POOL_MAGIC, __ATOMIC_RELEASE);
+}
+
+/*
+ * maps the segment, creating it if there is none, and counts this process in
+ *  A segment whose last process just left is about to be removed, so we wait for that and create a new one.
+ */
+static RC mapSegment(BM_SharedPool *pool, const SharedHeader *shape) {
+    long long deadline = nowMillis() + SHARED_ATTACH_MILLIS;
+    struct stat st;
+
+    while (nowMillis() < deadline) {
+        bool created = TRUE;
+        int fd = shm_open(pool->shmName, O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0 && errno == EEXIST) {
+            created = FALSE;
+            fd = shm_open(pool->shmName, O_RDWR, 0);
+        }
+        if (fd < 0 && errno == ENOENT)
+            continue; // removed between the two opens
+        if (fd < 0)
+            return RC_FILE_NOT_FOUND;
+
+        if (created && ftruncate(fd, (off_t) pool->size) != 0) {
+            close(fd);
+            shm_unlink(pool->shmName);
+            return RC_WRITE_FAILED;
+        }
+        // the creator may not have sized it yet; a size other than ours means another shape
+        while (!created && fstat(fd, &st) == 0 && st.st_size == 0 && nowMillis() < deadline)
+            sleepBriefly();
+        if (!created && (fstat(fd, &st) != 0 || st.st_size != (off_t) pool->size)) {
+            close(fd);
+            return RC_WRITE_FAILED;
+        }
+        SharedHeader *h = mmap(NULL, pool->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (h == MAP_FAILED) {
+            if (created)
+                shm_unlink(pool->shmName);
+            return RC_WRITE_FAILED;
+        }
+        if (created)
+            initSegment(h, shape, pool->fileName);
+        while (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != SHARED_POOL_MAGIC && nowMillis() < deadline)
+            sleepBriefly();
+        if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != SHARED_POOL_MAGIC) {
+            munmap(h, pool->size);
+            return RC_WRITE_FAILED;
+        }
+
+        lockPool(h);
+        if (h->closed) {
+            unlockPool(h);
+            munmap(h, pool->size);
+            sleepBriefly();
+            continue;
+        }
+        if (h->numPages != shape->numPages || h->pageSize != shape->pageSize
+            || strcmp(h->fileName, pool->fileName) != 0) {
+            unlockPool(h);
+            munmap(h, pool->size);
+            return RC_WRITE_FAILED;
+        }
+        clearDeadProcesses(h);
+        for (pool->slot = 0; pool->slot < SHARED_MAX_PROCS && h->procs[pool->slot] != 0; pool->slot++)
+            ;
+        if (pool->slot == SHARED_MAX_PROCS) {
+            unlockPool(h);
+            munmap(h, pool->size);
+            return RC_WRITE_FAILED;
+        }
+        h->procs[pool->slot] = getpid();
+        h->attached++;
+        unlockPool(h);
+        pool->hdr = h;
+        return RC_OK;
+    }
+    return RC_WRITE_FAILED;
+}
+
+static void freePool(BM_SharedPool *pool) {
+    free(pool->shmName);
+    free(pool->fileName);
+    free(pool->shadow);
+    free(pool);
+}
+
+RC attachSharedPool(BM_SharedPool **pool, const char *const shmName, const char *const pageFileName,
+                    const int numPages) {
+    SharedHeader shape;
+    BM_SharedPool *p;
+    RC rc;
+
+    if (numPages <= 0 || strlen(pageFileName) >= SHARED_NAME_LEN)
+        return RC_WRITE_FAILED;
+    p = calloc(1, sizeof(BM_SharedPool));
+    p->shmName = strdup(shmName);
+    p->fileName = strdup(pageFileName);
+    if (openPageFile(p->fileName, &p->fh) != RC_OK) {
+        freePool(p);
+        return RC_FILE_NOT_FOUND;
+    }
+    if ((rc = refreshPageFile(&p->fh)) == RC_OK) { // a compressed file can't be shared
+        p->size = segmentShape(&shape, numPages, p->fh.pageSize);
+        rc = mapSegment(p, &shape);
+    }
+    if (rc != RC_OK) {
+        closePageFile(&p->fh);
+        freePool(p);
+        return rc;
+    }
+
+    p->frames = (SharedFrame *) ((char *) p->hdr + p->hdr->framesOffset);
+    p->table = (int *) ((char *) p->hdr + p->hdr->tableOffset);
+    p->data = (char *) p->hdr + p->hdr->dataOffset;
+    p->shadow = malloc(p->fh.pageSize);
+    *pool = p;
+    return RC_OK;
+}
+
+/*
+ * Detaches this process from the pool
+ *  The last process to detach writes back the dirty pages and removes the segment. It does so without letting go of
+ *  the latch, so a process attaching meanwhile waits, finds the segment closed and creates a new one, which reads the
+ *  pages back from the file. Processes that died without detaching don't count; the reads and writes they left
+ *  unfinished are cleared first.
+ */
+RC detachSharedPool(BM_SharedPool *pool) {
+    SharedHeader *h = pool->hdr;
+    RC rc = RC_OK;
+    bool last;
+
+    if (pool->pins > 0)
+        return RC_WRITE_FAILED;
+    lockPool(h);
+    clearDeadProcesses(h);
+    if (h->attached == 1) {
+        for (int i = 0; i < h->numPages; i++)
+            clearDeadIO(pool, i);
+        for (int i = 0; i < h->numPages && rc == RC_OK; i++) {
+            SharedFrame *f = &pool->frames[i];
+            if (f->pageNum == NO_PAGE || !f->dirty)
+                continue;
+            if (refreshPageFile(&pool->fh) != RC_OK || writeBlock(f->pageNum, &pool->fh, frameData(pool, i)) != RC_OK)
+                rc = RC_WRITE_FAILED;
+            else {
+                f->dirty = 0;
+                h->numWrite++;
+            }
+        }
+        if (rc == RC_OK)
+            h->closed = 1;
+    }
+    if (rc == RC_OK) {
+        h->procs[pool->slot] = 0;
+        h->attached--;
+    }
+    last = h->closed;
+    unlockPool(h);
+    if (rc != RC_OK)
+        return rc;
+
+    if (last)
+        shm_unlink(pool->shmName);
+    munmap(pool->hdr, pool->size);
+    closePageFile(&pool->fh);
+    freePool(pool);
+    return RC_OK;
+}
+
+/*
+ * Pins the page, reading it into a frame of the segment if no process has it yet
+ *  A page another process is reading in is waited for, not read again. The victim is chosen by CLOCK; a dirty one is
+ *  written back first (without the latch) and then the search starts over, as the page may have come in meanwhile.
+ */
+RC pinSharedPage(BM_SharedPool *pool, BM_PageHandle *const page, const PageNumber pageNum) {
+    SharedHeader *h = pool->hdr;
+    SharedFrame *f;
+    int i;
+    RC rc;
+
+    if (pageNum < 0)
+        return RC_READ_NON_EXISTING_PAGE;
+    lockPool(h);
+    while (1) {
+        if ((i = tableFind(pool, pageNum)) >= 0) {
+            f = &pool->frames[i];
+            if (f->reading) {
+                waitForIO(pool, i);
+                continue;
+            }
+            f->fixCount++;
+            f->referenced = 1;
+            unlockPool(h);
+            pool->pins++;
+            page->pageNum = pageNum;
+            page->data = frameData(pool, i);
+            return RC_OK;
+        }
+        if ((i = clockVictim(pool)) < 0) {
+            unlockPool(h);
+            return RC_WRITE_FAILED; // every page is fixed
+        }
+        if (!pool->frames[i].dirty)
+            break;
+        if (writeBack(pool, i) != RC_OK) {
+            unlockPool(h);
+            return RC_WRITE_FAILED;
+        }
+    }
+
+    f = &pool->frames[i];
+    if (f->pageNum != NO_PAGE)
+        tableRemove(pool, i);
+    f->pageNum = pageNum;
+    f->fixCount = 1;
+    f->referenced = 1;
+    f->dirty = 0;
+    f->reading = 1;
+    f->ioOwner = getpid();
+    tableInsert(pool, i);
+    h->numRead++;
+    // growing the file is the one write every process could do at once, so it's done under the latch
+    rc = refreshPageFile(&pool->fh);
+    if (rc == RC_OK && pageNum >= pool->fh.totalNumPages)
+        rc = ensureCapacity(pageNum + 1, &pool->fh);
+    unlockPool(h);
+
+    if (rc == RC_OK)
+        rc = readBlock(pageNum, &pool->fh, frameData(pool, i));
+
+    lockPool(h);
+    f->reading = 0;
+    f->ioOwner = 0;
+    if (rc != RC_OK) { // don't leave a half-read page behind
+        tableRemove(pool, i);
+        f->pageNum = NO_PAGE;
+        f->fixCount = 0;
+        f->referenced = 0;
+    }
+    unlockPool(h);
+    if (rc != RC_OK)
+        return RC_WRITE_FAILED;
+    pool->pins++;
+    page->pageNum = pageNum;
+    page->data = frameData(pool, i);
+    return RC_OK;
+}
+
+RC unpinSharedPage(BM_SharedPool *pool, BM_PageHandle *const page) {
+    SharedHeader *h = pool->hdr;
+    int i;
+
+    lockPool(h);
+    i = tableFind(pool, page->pageNum);
+    if (i < 0 || pool->frames[i].reading || pool->frames[i].fixCount <= 0 || pool->pins <= 0) {
+        unlockPool(h);
+        return RC_WRITE_FAILED;
+    }
+    pool->frames[i].fixCount--;
+    unlockPool(h);
+    pool->pins--;
+    return RC_OK;
+}
+
+RC markSharedDirty(BM_SharedPool *pool, BM_PageHandle *const page) {
+    SharedHeader *h = pool->hdr;
+    int i;
+
+    lockPool(h);
+    i = tableFind(pool, page->pageNum);
+    if (i < 0 || pool->frames[i].reading) {
+        unlockPool(h);
+        return RC_WRITE_FAILED;
+    }
+    pool->frames[i].dirty = 1;
+    unlockPool(h);
+    return RC_OK;
+}
+
+/*
+ * writes the page back, pinned or not, from a copy like every write-back
+ *  A write of the page that is in flight already is waited for first.
+ */
+RC forceSharedPage(BM_SharedPool *pool, BM_PageHandle *const page) {
+    SharedHeader *h = pool->hdr;
+    RC rc;
+    int i;
+
+    lockPool(h);
+    while ((i = tableFind(pool, page->pageNum)) >= 0 && pool->frames[i].writing)
+        waitForIO(pool, i);
+    rc = i < 0 || pool->frames[i].reading ? RC_WRITE_FAILED : writeBack(pool, i);
+    unlockPool(h);
+    return rc;
+}
+
+/*
+ * writes back every dirty page of the pool, whichever process dirtied it
+ *  A frame that is being written already is waited for, and written again if it got dirty meanwhile.
+ */
+RC forceFlushSharedPool(BM_SharedPool *pool) {
+    SharedHeader *h = pool->hdr;
+    RC rc = RC_OK;
+
+    lockPool(h);
+    for (int i = 0; i < h->numPages && rc == RC_OK; i++) {
+        SharedFrame *f = &pool->frames[i];
+        while (f->writing)
+            waitForIO(pool, i);
+        if (f->pageNum != NO_PAGE && f->dirty && !f->reading)
+            rc = writeBack(pool, i);
+    }
+    unlockPool(h);
+    return rc;
+}
+
+/*
+ * the free, pinned and dirty frames of the pool; oldestDirtyNanos isn't kept and is always 0, bufferBytes is the
+ * segment's page data
+ */
+RC getSharedPoolCounts(BM_SharedPool *pool, BM_PoolCounts *counts) {
+    SharedHeader *h = pool->hdr;
+
+    counts->numFree = counts->numPinned = counts->numDirty = 0;
+    counts->oldestDirtyNanos = 0;
+    counts->bufferBytes = (long long) h->numPages * h->pageSize;
+    lockPool(h);
+    for (int i = 0; i < h->numPages; i++) {
+        SharedFrame *f = &pool->frames[i];
+        counts->numFree += f->pageNum == NO_PAGE;
+        counts->numPinned += f->fixCount > 0;
+        counts->numDirty += f->pageNum != NO_PAGE && f->dirty;
+    }
+    unlockPool(h);
+    return RC_OK;
+}
+
+int getSharedNumReadIO(BM_SharedPool *pool) {
+    return __atomic_load_n(&pool->hdr->numRead, __ATOMIC_RELAXED);
+}
+
+int getSharedNumWriteIO(BM_SharedPool *pool) {
+    return __atomic_load_n(&pool->hdr->numWrite, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,38 @@
+#ifndef SHARED_POOL_H
+#define SHARED_POOL_H
+
+#include "buffer_mgr.h"
+
+// Shared buffer pools
+// A buffer pool for one page file whose frames, page table and replacement state live in a POSIX shared memory
+// segment, so that several processes working on the same file share one cache: a hot page is cached (and read) once
+// for all of them, and a page one process dirtied is what the others see, without a write in between.
+// The first process to attach creates the segment, the others map it; the last one to detach writes back the dirty
+// pages and removes it. A process-shared latch guards the page table and the frame state; it's never held across
+// I/O, so one process's miss doesn't stall the others. Replacement is CLOCK. Every process does its I/O through its
+// own handle on the page file, which can't be a compressed page file.
+// A process that dies attached leaves its pins behind, but not its unfinished reads and writes, and doesn't keep the
+// last live process from removing the segment.
+
+typedef struct BM_SharedPool BM_SharedPool;
+
+// attaches to the pool called shmName (ie "/orders"), creating it with numPages frames if it doesn't exist yet.
+// Throws RC_WRITE_FAILED if it exists with another size or page file, or has 64 attachments already.
+RC attachSharedPool (BM_SharedPool **pool, const char *const shmName, const char *const pageFileName,
+		const int numPages);
+// throws an error if this process still holds pins
+RC detachSharedPool (BM_SharedPool *pool);
+
+// like their BM_BufferPool counterparts; page->data points into the shared segment
+RC pinSharedPage (BM_SharedPool *pool, BM_PageHandle *const page, const PageNumber pageNum);
+RC unpinSharedPage (BM_SharedPool *pool, BM_PageHandle *const page);
+RC markSharedDirty (BM_SharedPool *pool, BM_PageHandle *const page);
+RC forceSharedPage (BM_SharedPool *pool, BM_PageHandle *const page);
+RC forceFlushSharedPool (BM_SharedPool *pool);
+
+// over every process attached to the pool
+RC getSharedPoolCounts (BM_SharedPool *pool, BM_PoolCounts *counts);
+int getSharedNumReadIO (BM_SharedPool *pool);
+int getSharedNumWriteIO (BM_SharedPool *pool);
+
+#endif
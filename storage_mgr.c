@@ -3,45 +3,377 @@
 //
 
 #include "storage_mgr.h"
+#include "page_compress.h"
+#include "dt.h"
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <unistd.h>
+
+// Every page file starts with a header block (one page long) recording the file's page size.
+// Page n lives at (n + 1) * pageSize. Files written before the header existed have no magic number;
+// they are read as headerless PAGE_SIZE files.
+//
+// A compressed page file (SM_FILE_COMPRESSED) keeps the header block, but its pages are stored compressed, each in a
+// slot somewhere after the header, and a page map (page number -> slot offset and length) says where. The map is
+// cached in memory while the file is open, so reading a page is still a single read of its slot.
+// Nothing the map on disk refers to is overwritten: a page written for the first time since that map gets a new slot,
+// and its old slot is only freed once a newer map is durable. A page written again before then stays in its new slot
+// if it still fits. syncPageFile and closePageFile write the map the same way, to free space, sync it with the pages,
+// and only then point the header to it and sync again, which frees the old map and the old slots. So the file always
+// has a whole map whose slots hold what it says, and a file that is rewritten and synced over and over stops growing.
+// Free space isn't kept in the file: openPageFile works it out from the map. Pages written after the last sync are
+// lost with the map if the process dies.
+#define PAGE_FILE_MAGIC 0x4c465047 // "GPFL"
+#define SM_FILE_COMPRESSED 1
+#define SLOT_ALIGN 64              // slots and maps are rounded up, so a page that grows a little can stay where it is
+#define ALIGN_SLOT(n) (((n) + SLOT_ALIGN - 1) & ~((long long) SLOT_ALIGN - 1))
+
+typedef struct SM_FileHeader {
+    int magic;
+    int pageSize;
+    int flags;          // SM_FILE_*, 0 in files written before compression existed
+    int numPages;       // compressed files only, like the rest
+    long long mapOffset;
+} SM_FileHeader;
+
+typedef struct SM_PageSlot {
+    long long offset;   // 0 if the page was never written: it reads as zeros
+    int length;         // == pageSize if the page didn't compress and is stored as is
+    int capacity;
+} SM_PageSlot;
+
+// a stretch of a compressed file
+typedef struct SM_Extent {
+    long long offset;
+    long long size;
+} SM_Extent;
+
+typedef struct SM_ExtentList {
+    SM_Extent *items;   // ordered by offset, with neighbours merged
+    int count;
+    int capacity;
+} SM_ExtentList;
+
+// what mgmtInfo points to
+typedef struct SM_FileInfo {
+    FILE *fp;
+    long dataOffset; // where page 0 starts
+
+    // compressed files only
+    bool compressed;
+    SM_PageSlot *map;
+    unsigned char *fresh; // per page: its slot was taken after the map on disk was written, which doesn't refer to it
+    int mapCapacity;
+    bool mapDirty;   // the map on disk is out of date
+    long long mapOffset;  // where the map on disk is, and how much space it takes
+    long long mapSize;
+    long long fileEnd;    // where the last map or slot ends
+    SM_ExtentList freeSpace;     // space no map refers to, taken for new slots and maps before the end of the file
+    SM_ExtentList pendingSpace;  // space only the map on disk refers to, free once a newer map is durable
+    char *scratch;   // compressed form of the page being read or written
+} SM_FileInfo;
+
+/*
+ * page sizes are powers of two between MIN_PAGE_SIZE and MAX_PAGE_SIZE
+ */
+static bool validPageSize(int pageSize) {
+    return pageSize >= MIN_PAGE_SIZE && pageSize <= MAX_PAGE_SIZE && (pageSize & (pageSize - 1)) == 0;
+}
+
+static FILE *fileOf(SM_FileHandle *fHandle) {
+    SM_FileInfo *info = fHandle->mgmtInfo;
+    return info ? info->fp : NULL;
+}
+
+static long pageOffset(SM_FileHandle *fHandle, int pageNum) {
+    SM_FileInfo *info = fHandle->mgmtInfo;
+    return info->dataOffset + (long) pageNum * fHandle->pageSize;
+}
+
+/*
+ * makes room in the page map for numPages pages, the new ones never written
+ */
+static void growMap(SM_FileInfo *info, int numPages) {
+    if (numPages <= info->mapCapacity)
+        return;
+    int capacity = info->mapCapacity > 0 ? info->mapCapacity : 16;
+    while (capacity < numPages)
+        capacity *= 2;
+    info->map = realloc(info->map, sizeof(SM_PageSlot) * capacity);
+    info->fresh = realloc(info->fresh, capacity);
+    memset(info->map + info->mapCapacity, 0, sizeof(SM_PageSlot) * (capacity - info->mapCapacity));
+    memset(info->fresh + info->mapCapacity, 0, capacity - info->mapCapacity);
+    info->mapCapacity = capacity;
+}
+
+/*
+ * adds a stretch of the file to the list, merging it with the ones it touches
+ */
+static void addExtent(SM_ExtentList *list, long long offset, long long size) {
+    int i = 0;
+
+    if (size <= 0)
+        return;
+    while (i < list->count && list->items[i].offset < offset)
+        i++;
+    if (i > 0 && list->items[i - 1].offset + list->items[i - 1].size == offset) {
+        list->items[i - 1].size += size;
+        if (i < list->count && offset + size == list->items[i].offset) {
+            list->items[i - 1].size += list->items[i].size;
+            memmove(list->items + i, list->items + i + 1, sizeof(SM_Extent) * (list->count - i - 1));
+            list->count--;
+        }
+        return;
+    }
+    if (i < list->count && offset + size == list->items[i].offset) {
+        list->items[i].offset = offset;
+        list->items[i].size += size;
+        return;
+    }
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity > 0 ? 2 * list->capacity : 16;
+        list->items = realloc(list->items, sizeof(SM_Extent) * list->capacity);
+    }
+    memmove(list->items + i + 1, list->items + i, sizeof(SM_Extent) * (list->count - i));
+    list->items[i] = (SM_Extent) {offset, size};
+    list->count++;
+}
+
+/*
+ * frees space no map refers to any more; free space at the end of the file moves the end back
+ */
+static void releaseSpace(SM_FileInfo *info, long long offset, long long size) {
+    SM_ExtentList *list = &info->freeSpace;
+
+    addExtent(list, offset, size);
+    if (list->count > 0 && list->items[list->count - 1].offset + list->items[list->count - 1].size == info->fileEnd)
+        info->fileEnd = list->items[--list->count].offset;
+}
+
+/*
+ * takes size bytes of free space, the first stretch they fit in, or the end of the file
+ */
+static long long takeSpace(SM_FileInfo *info, long long size) {
+    SM_ExtentList *list = &info->freeSpace;
+    long long offset;
+
+    for (int i = 0; i < list->count; i++) {
+        SM_Extent *e = &list->items[i];
+        if (e->size < size)
+            continue;
+        offset = e->offset;
+        e->offset += size;
+        e->size -= size;
+        if (e->size == 0) {
+            memmove(e, e + 1, sizeof(SM_Extent) * (list->count - i - 1));
+            list->count--;
+        }
+        return offset;
+    }
+    offset = info->fileEnd;
+    info->fileEnd += size;
+    return offset;
+}
+
+static int compareExtents(const void *a, const void *b) {
+    long long x = ((const SM_Extent *) a)->offset, y = ((const SM_Extent *) b)->offset;
+    return (x > y) - (x < y);
+}
+
+/*
+ * works out the free space of a compressed file just opened: whatever lies between the header block, the map and the
+ *  slots. The file ends where the last of them does.
+ */
+static void findFreeSpace(SM_FileHandle *fHandle) {
+    SM_FileInfo *info = fHandle->mgmtInfo;
+    SM_Extent *used = malloc(sizeof(SM_Extent) * (fHandle->totalNumPages + 1));
+    long long end = info->dataOffset;
+    int n = 0;
+
+    used[n++] = (SM_Extent) {info->mapOffset, info->mapSize};
+    for (int i = 0; i < fHandle->totalNumPages; i++)
+        if (info->map[i].offset != 0)
+            used[n++] = (SM_Extent) {info->map[i].offset, info->map[i].capacity};
+    qsort(used, n, sizeof(SM_Extent), compareExtents);
+    for (int i = 0; i < n; i++) {
+        if (used[i].offset > end)
+            addExtent(&info->freeSpace, end, used[i].offset - end);
+        if (used[i].offset + used[i].size > end)
+            end = used[i].offset + used[i].size;
+    }
+    info->fileEnd = end;
+    free(used);
+}
+
+/*
+ * makes the page map durable: writes it to free space and syncs it with the pages, then points the header to it and
+ *  syncs again. Only then are the old map and the slots only it referred to free.
+ */
+static RC writeMap(SM_FileHandle *fHandle) {
+    SM_FileInfo *info = fHandle->mgmtInfo;
+    size_t n = fHandle->totalNumPages;
+    long long size = ALIGN_SLOT((long long) (sizeof(SM_PageSlot) * n));
+    long long offset;
+    int fd = fileno(info->fp);
+
+    if (!info->mapDirty)
+        return RC_OK;
+    offset = takeSpace(info, size);
+    SM_FileHeader header = {PAGE_FILE_MAGIC, fHandle->pageSize, SM_FILE_COMPRESSED, fHandle->totalNumPages, offset};
+    if (fseek(info->fp, (long) offset, SEEK_SET) != 0
+        || fwrite(info->map, sizeof(SM_PageSlot), n, info->fp) != n
+        || fflush(info->fp) != 0 || fdatasync(fd) != 0
+        || fseek(info->fp, 0, SEEK_SET) != 0
+        || fwrite(&header, sizeof(header), 1, info->fp) != 1
+        || fflush(info->fp) != 0 || fdatasync(fd) != 0) {
+        // the header may point to the new map already, so its space isn't reused before a later map is durable
+        addExtent(&info->pendingSpace, offset, size);
+        return RC_WRITE_FAILED;
+    }
+    releaseSpace(info, info->mapOffset, info->mapSize);
+    for (int i = 0; i < info->pendingSpace.count; i++)
+        releaseSpace(info, info->pendingSpace.items[i].offset, info->pendingSpace.items[i].size);
+    info->pendingSpace.count = 0;
+    memset(info->fresh, 0, info->mapCapacity);
+    info->mapOffset = offset;
+    info->mapSize = size;
+    info->mapDirty = FALSE;
+    return RC_OK;
+}
+
 void initStorageManager(void) {
 
 }
 
 RC createPageFile(char *fileName) {
+    return createPageFileWithSize(fileName, PAGE_SIZE);
+}
+
+/*
+ * creates a page file with one empty page, whose pages are pageSize bytes
+ *  pageSize has to be a power of two between MIN_PAGE_SIZE and MAX_PAGE_SIZE
+ */
+RC createPageFileWithSize(char *fileName, int pageSize) {
+    if (!validPageSize(pageSize))
+        return RC_INVALID_PAGE_SIZE;
+
     FILE *p = fopen(fileName, "w");
-    const char c_size[PAGE_SIZE] = {'\0'};
+    char *c_size = calloc(2, pageSize); // the header block and the first page
+    SM_FileHeader header = {PAGE_FILE_MAGIC, pageSize, 0, 0, 0};
+    RC rc = RC_OK;
 
-    if (!p)
+    if (!p) {
+        free(c_size);
         return RC_FILE_NOT_FOUND;
-    if (!fwrite(c_size, sizeof(char), PAGE_SIZE, p))
-        return RC_WRITE_FAILED;
+    }
+    memcpy(c_size, &header, sizeof(header));
+    if (fwrite(c_size, sizeof(char), 2 * pageSize, p) != 2 * pageSize)
+        rc = RC_WRITE_FAILED;
+    free(c_size);
     if (fclose(p) != 0)
         return RC_FILE_NOT_FOUND;
-    return RC_OK;
+    return rc;
+}
+
+/*
+ * creates a compressed page file with one empty page: the header block and a page map that says page 0 was never
+ *  written
+ */
+RC createCompressedPageFile(char *fileName, int pageSize) {
+    if (!validPageSize(pageSize))
+        return RC_INVALID_PAGE_SIZE;
+
+    FILE *p = fopen(fileName, "w");
+    char *block = calloc(1, pageSize);
+    SM_FileHeader header = {PAGE_FILE_MAGIC, pageSize, SM_FILE_COMPRESSED, 1, pageSize};
+    SM_PageSlot empty = {0, 0, 0};
+    RC rc = RC_OK;
+
+    if (!p) {
+        free(block);
+        return RC_FILE_NOT_FOUND;
+    }
+    memcpy(block, &header, sizeof(header));
+    if (fwrite(block, sizeof(char), pageSize, p) != pageSize || fwrite(&empty, sizeof(empty), 1, p) != 1)
+        rc = RC_WRITE_FAILED;
+    free(block);
+    if (fclose(p) != 0)
+        return RC_FILE_NOT_FOUND;
+    return rc;
 }
 
 RC openPageFile(char *fileName, SM_FileHandle *fHandle) {
-    FILE *p = fHandle->mgmtInfo = fopen(fileName, "r+");
+    FILE *p = fopen(fileName, "r+");
+    SM_FileHeader header;
 
     if (!p) {
         strerror(errno);
         return RC_FILE_NOT_FOUND;
     }
 
-    long int cur = ftell(p);
+    SM_FileInfo *info = calloc(1, sizeof(SM_FileInfo));
+    info->fp = p;
+    if (fread(&header, sizeof(header), 1, p) == 1 && header.magic == PAGE_FILE_MAGIC) {
+        // a corrupt header would have us divide by its page size, or allocate whatever it says
+        RC bad = !validPageSize(header.pageSize) ? RC_INVALID_PAGE_SIZE
+                 : (header.flags & SM_FILE_COMPRESSED) && header.numPages < 0 ? RC_COMPRESSED_PAGE_CORRUPT : RC_OK;
+        if (bad != RC_OK) {
+            fclose(p);
+            free(info);
+            return bad;
+        }
+        fHandle->pageSize = header.pageSize;
+        info->dataOffset = header.pageSize;
+        info->compressed = (header.flags & SM_FILE_COMPRESSED) != 0;
+    } else {
+        fHandle->pageSize = PAGE_SIZE;
+        info->dataOffset = 0;
+    }
+    fHandle->mgmtInfo = info;
+
     fHandle->fileName = fileName;
-    fHandle->curPagePos = (int) (ftell(p) / PAGE_SIZE);
+    fHandle->curPagePos = 0;
     fseek(p, 0, SEEK_END);
-    fHandle->totalNumPages = (int) (ftell(p) / PAGE_SIZE);
-    fseek(p, cur, SEEK_SET);
+    if (info->compressed) {
+        // the page count is in the header, and the map is read once and kept
+        growMap(info, header.numPages);
+        if (fseek(p, (long) header.mapOffset, SEEK_SET) != 0
+            || fread(info->map, sizeof(SM_PageSlot), header.numPages, p) != header.numPages) {
+            fHandle->mgmtInfo = NULL;
+            fclose(p);
+            free(info->map);
+            free(info->fresh);
+            free(info);
+            return RC_COMPRESSED_PAGE_CORRUPT;
+        }
+        fHandle->totalNumPages = header.numPages;
+        info->mapOffset = header.mapOffset;
+        info->mapSize = (long long) sizeof(SM_PageSlot) * header.numPages;
+        findFreeSpace(fHandle);
+        info->scratch = malloc(COMPRESS_BOUND(fHandle->pageSize));
+    } else
+        fHandle->totalNumPages = (int) ((ftell(p) - info->dataOffset) / fHandle->pageSize);
+    fseek(p, info->dataOffset, SEEK_SET);
 
     return RC_OK;
 }
 
 RC closePageFile(SM_FileHandle *fHandle) {
-    if (fclose(fHandle->mgmtInfo) != 0)
+    SM_FileInfo *info = fHandle->mgmtInfo;
+    RC mapRc = info->compressed ? writeMap(fHandle) : RC_OK;
+    int rc = fclose(info->fp);
+
+    free(info->map);
+    free(info->fresh);
+    free(info->freeSpace.items);
+    free(info->pendingSpace.items);
+    free(info->scratch);
+    free(info);
+    fHandle->mgmtInfo = NULL;
+    if (mapRc != RC_OK)
+        return mapRc;
+    if (rc != 0)
         return RC_FILE_NOT_FOUND;
     return RC_OK;
 }
@@ -52,20 +384,84 @@ RC destroyPageFile(char *fileName) {
     return RC_OK;
 }
 
+/*
+ * reads a page of a compressed file: one read of its slot
+ */
+static RC readCompressedBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    SM_FileInfo *info = fHandle->mgmtInfo;
+    SM_PageSlot *slot = &info->map[pageNum];
+
+    if (slot->offset == 0) {
+        memset(memPage, 0, fHandle->pageSize);
+        return RC_OK;
+    }
+    if (fseek(info->fp, (long) slot->offset, SEEK_SET) != 0)
+        return RC_READ_NON_EXISTING_PAGE;
+    if (slot->length == fHandle->pageSize)
+        return fread(memPage, sizeof(char), slot->length, info->fp) == slot->length ? RC_OK : -1;
+    if (fread(info->scratch, sizeof(char), slot->length, info->fp) != slot->length)
+        return -1;
+    return decompressPage(info->scratch, slot->length, memPage, fHandle->pageSize);
+}
+
+/*
+ * writes a page of a compressed file into its slot, if the map on disk doesn't refer to it and the page still fits,
+ *  otherwise into a new one
+ */
+static RC writeCompressedBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
+    SM_FileInfo *info = fHandle->mgmtInfo;
+    SM_PageSlot *slot = &info->map[pageNum];
+    int length = compressPage(memPage, fHandle->pageSize, info->scratch, fHandle->pageSize - 1);
+    const char *data = info->scratch;
+
+    if (length < 0) {
+        length = fHandle->pageSize;
+        data = memPage;
+    }
+    if (slot->offset == 0 || !info->fresh[pageNum] || length > slot->capacity) {
+        if (slot->offset != 0 && info->fresh[pageNum])
+            releaseSpace(info, slot->offset, slot->capacity);
+        else if (slot->offset != 0) // a crash before the next map is durable still needs it
+            addExtent(&info->pendingSpace, slot->offset, slot->capacity);
+        slot->capacity = (int) ALIGN_SLOT(length);
+        slot->offset = takeSpace(info, slot->capacity);
+        info->fresh[pageNum] = 1;
+        info->mapDirty = TRUE;
+    }
+    if (slot->length != length)
+        info->mapDirty = TRUE;
+    slot->length = length;
+    if (fseek(info->fp, (long) slot->offset, SEEK_SET) != 0
+        || fwrite(data, sizeof(char), length, info->fp) != length
+        || fflush(info->fp) != 0)
+        return RC_WRITE_FAILED;
+    return RC_OK;
+}
+
 /* reading blocks from disc */
 RC readBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
     if(!fHandle)
         return RC_FILE_HANDLE_NOT_INIT;
-    FILE *fp = fHandle->mgmtInfo;
+    FILE *fp = fileOf(fHandle);
     if (!fp)
         return RC_FILE_HANDLE_NOT_INIT;
     if (pageNum < 0 || pageNum > fHandle->totalNumPages)
         return RC_READ_NON_EXISTING_PAGE;
 
+    if (((SM_FileInfo *) fHandle->mgmtInfo)->compressed) {
+        RC rc;
+        if (pageNum >= fHandle->totalNumPages)
+            return RC_READ_NON_EXISTING_PAGE;
+        if ((rc = readCompressedBlock(pageNum, fHandle, memPage)) != RC_OK)
+            return rc;
+        fHandle->curPagePos = pageNum;
+        return RC_OK;
+    }
+
     //finally, read the block
-    if (fseek(fp, pageNum * PAGE_SIZE, SEEK_SET) != 0)
+    if (fseek(fp, pageOffset(fHandle, pageNum), SEEK_SET) != 0)
         return RC_READ_NON_EXISTING_PAGE;
-    if (fread(memPage, sizeof(char), PAGE_SIZE, fp) != PAGE_SIZE)
+    if (fread(memPage, sizeof(char), fHandle->pageSize, fp) != fHandle->pageSize)
         return -1; // the read failed somehow
 
     fHandle->curPagePos = pageNum;
@@ -106,7 +502,7 @@ RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
         return RC_FILE_HANDLE_NOT_INIT;
 
     int RC;
-    FILE* fp = fHandle->mgmtInfo;
+    FILE* fp = fileOf(fHandle);
 
     if(!fp)
         return RC_FILE_HANDLE_NOT_INIT;
@@ -116,10 +512,22 @@ RC writeBlock(int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage) {
     if ((RC = ensureCapacity(pageNum, fHandle)) != RC_OK) // for if pageNum > totalPageNum
         return RC;
 
-    if (fseek(fp, (PAGE_SIZE * pageNum), SEEK_SET) != 0)
+    if (((SM_FileInfo *) fHandle->mgmtInfo)->compressed) {
+        if (pageNum >= fHandle->totalNumPages && (RC = appendEmptyBlock(fHandle)) != RC_OK)
+            return RC;
+        if ((RC = writeCompressedBlock(pageNum, fHandle, memPage)) != RC_OK)
+            return RC;
+        fHandle->curPagePos = pageNum;
+        return RC_OK;
+    }
+
+    if (fseek(fp, pageOffset(fHandle, pageNum), SEEK_SET) != 0)
         return RC_WRITE_FAILED;
 
-    if (fwrite(memPage, sizeof(char), PAGE_SIZE, fp) != PAGE_SIZE)
+    if (fwrite(memPage, sizeof(char), fHandle->pageSize, fp) != fHandle->pageSize)
+        return RC_WRITE_FAILED;
+    // hand the page to the OS right away, so the next syncPageFile covers it
+    if (fflush(fp) != 0)
         return RC_WRITE_FAILED;
 
     fHandle->curPagePos = pageNum;
@@ -132,17 +540,66 @@ RC writeCurrentBlock(SM_FileHandle *fHandle, SM_PageHandle memPage) {
     return writeBlock(fHandle->curPagePos, fHandle, memPage);
 }
 
+/*
+ * makes every page written so far durable: fdatasync, so metadata that doesn't matter for reading the data back
+ * (ie the modification time) isn't synced
+ */
+RC syncPageFile(SM_FileHandle *fHandle) {
+    FILE *fp = fileOf(fHandle);
+
+    if (!fp)
+        return RC_FILE_HANDLE_NOT_INIT;
+    // a compressed file's pages can only be found through the map, so it has to be durable as well; writeMap syncs
+    if (((SM_FileInfo *) fHandle->mgmtInfo)->mapDirty)
+        return writeMap(fHandle);
+    if (fflush(fp) != 0 || fdatasync(fileno(fp)) != 0)
+        return RC_WRITE_FAILED;
+    return RC_OK;
+}
+
+/*
+ * picks up what other processes did to the file since it was opened: drops whatever stdio has buffered, so the next
+ * read goes to the file, and recounts the pages. A compressed file's page map is only read at open, so it can't be
+ * shared this way: RC_WRITE_FAILED.
+ */
+RC refreshPageFile(SM_FileHandle *fHandle) {
+    FILE *fp = fileOf(fHandle);
+    SM_FileInfo *info = fHandle->mgmtInfo;
+
+    if (!fp)
+        return RC_FILE_HANDLE_NOT_INIT;
+    if (info->compressed)
+        return RC_WRITE_FAILED;
+    if (fflush(fp) != 0 || fseek(fp, 0, SEEK_END) != 0)
+        return RC_FILE_NOT_FOUND;
+    fHandle->totalNumPages = (int) ((ftell(fp) - info->dataOffset) / fHandle->pageSize);
+    return RC_OK;
+}
+
 RC appendEmptyBlock(SM_FileHandle *fHandle) {
-    SM_PageHandle addon[PAGE_SIZE] = {'\0'};
+    FILE *fp = fileOf(fHandle);
+    SM_FileInfo *info = fHandle->mgmtInfo;
+
+    // a new page of a compressed file takes no space until it's written
+    if (info && info->compressed) {
+        growMap(info, fHandle->totalNumPages + 1);
+        fHandle->totalNumPages++;
+        info->mapDirty = TRUE;
+        return RC_OK;
+    }
 
-    if (fseek(fHandle->mgmtInfo, 0, SEEK_END) == 0) {
-        if (fwrite(addon, sizeof(char), PAGE_SIZE, fHandle->mgmtInfo)) {
+    char *addon = calloc(1, fHandle->pageSize);
+    RC rc = RC_WRITE_FAILED;
+
+    if (fp && fseek(fp, 0, SEEK_END) == 0) {
+        if (fwrite(addon, sizeof(char), fHandle->pageSize, fp) == fHandle->pageSize) {
             fHandle->totalNumPages++;
-            return RC_OK;
+            rc = RC_OK;
         }
     }
 
-    return RC_WRITE_FAILED;
+    free(addon);
+    return rc;
 }
 
 RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle) {
@@ -151,4 +608,4 @@ RC ensureCapacity(int numberOfPages, SM_FileHandle *fHandle) {
         if ((RC = appendEmptyBlock(fHandle)) != RC_OK)
             return RC;
     return RC_OK;
-}
\ No newline at end of file
+}
@@ -10,6 +10,7 @@ typedef struct SM_FileHandle {
 	char *fileName;
 	int totalNumPages;
 	int curPagePos;
+	int pageSize;       // bytes per page, recorded in the file's header
 	void *mgmtInfo;
 } SM_FileHandle;
 
@@ -21,6 +22,8 @@ typedef char* SM_PageHandle;
 /* manipulating page files */
 extern void initStorageManager (void);
 extern RC createPageFile (char *fileName);
+extern RC createPageFileWithSize (char *fileName, int pageSize);
+extern RC createCompressedPageFile (char *fileName, int pageSize);
 extern RC openPageFile (char *fileName, SM_FileHandle *fHandle);
 extern RC closePageFile (SM_FileHandle *fHandle);
 extern RC destroyPageFile (char *fileName);
@@ -39,5 +42,7 @@ extern RC writeBlock (int pageNum, SM_FileHandle *fHandle, SM_PageHandle memPage
 extern RC writeCurrentBlock (SM_FileHandle *fHandle, SM_PageHandle memPage);
 extern RC appendEmptyBlock (SM_FileHandle *fHandle);
 extern RC ensureCapacity (int numberOfPages, SM_FileHandle *fHandle);
+extern RC syncPageFile (SM_FileHandle *fHandle);
+extern RC refreshPageFile (SM_FileHandle *fHandle);
 
 #endif
@@ -1,12 +1,17 @@
 #include "storage_mgr.h"
 #include "buffer_mgr_stat.h"
 #include "buffer_mgr.h"
+#include "buffer_mgr_trace.h"
+#include "page_compress.h"
+#include "shared_pool.h"
 #include "dberror.h"
 #include "test_helper.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
 // var to store the current test's name
 char *testName;
@@ -45,6 +50,52 @@ static void testCLOCK(void);
 
 static void testLFU(void);
 
+static void testOptimisticRead(void);
+
+static void testMultipleFiles(void);
+
+static void testResize(void);
+
+static void testPrewarm(void);
+
+static void testPageSizes(void);
+
+static void testStatistics(void);
+
+static void testSnapshot(void);
+
+static void testTrace(void);
+
+static void testOptimal(void);
+
+static void testCleanFirst(void);
+
+static void testGroupSync(void);
+
+static void testCheckpoint(void);
+
+static void testFlushPinned(void);
+
+static void testCompressedTier(void);
+
+static void testCompressedPageFile(void);
+
+static void testPinnedCandidates(void);
+
+static void testDiscardPage(void);
+
+static void testFrameScan(void);
+
+static void testFrameBitsets(void);
+
+static void testCustomStrategy(void);
+
+static void testPageHints(void);
+
+static void testAsyncPin(void);
+
+static void testSharedPool(void);
+
 // main method
 int
 main(void) {
@@ -57,6 +108,29 @@ main(void) {
     testLRU();
     testCLOCK();
     testLFU();
+    testOptimisticRead();
+    testMultipleFiles();
+    testResize();
+    testPrewarm();
+    testPageSizes();
+    testStatistics();
+    testSnapshot();
+    testTrace();
+    testOptimal();
+    testCleanFirst();
+    testGroupSync();
+    testCheckpoint();
+    testFlushPinned();
+    testCompressedTier();
+    testCompressedPageFile();
+    testPinnedCandidates();
+    testDiscardPage();
+    testFrameScan();
+    testFrameBitsets();
+    testCustomStrategy();
+    testPageHints();
+    testAsyncPin();
+    testSharedPool();
 }
 
 // create n pages with content "Page X" and read them back to check whether the content is right
@@ -473,4 +547,1488 @@ void testLFU(void) {
     free(bm);
     free(h);
     TEST_DONE();
-}
\ No newline at end of file
+}
+
+void testOptimisticRead(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_PageHandle *w = MAKE_PAGE_HANDLE();
+    BM_ReadVersion v;
+    RC rc;
+    testName = "Testing optimistic reads";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+
+    // a page that isn't resident falls back to a regular pin
+    rc = beginOptimisticRead(bm, h, 0, &v);
+    ASSERT_EQUALS_INT(RC_BM_OPTIMISTIC_READ_FALLBACK, rc, "miss falls back to pinPage");
+    ASSERT_EQUALS_POOL("[0 1],[-1 0],[-1 0]", bm, "fallback pinned the page");
+    CHECK(unpinPage(bm, h));
+
+    // a resident page is read without pinning it
+    CHECK(beginOptimisticRead(bm, h, 0, &v));
+    ASSERT_EQUALS_STRING("Page-0", h->data, "optimistic read sees the page content");
+    ASSERT_EQUALS_POOL("[0 0],[-1 0],[-1 0]", bm, "optimistic read takes no pin");
+    CHECK(validateOptimisticRead(bm, h, v));
+
+    // a write in between invalidates the read, and validation pins the page instead
+    CHECK(beginOptimisticRead(bm, h, 0, &v));
+    CHECK(pinPage(bm, w, 0));
+    CHECK(markDirty(bm, w));
+    CHECK(unpinPage(bm, w));
+    rc = validateOptimisticRead(bm, h, v);
+    ASSERT_EQUALS_INT(RC_BM_OPTIMISTIC_READ_FALLBACK, rc, "write invalidates the read");
+    ASSERT_EQUALS_POOL("[0x1],[-1 0],[-1 0]", bm, "failed validation pinned the page");
+    CHECK(unpinPage(bm, h));
+
+    // so does evicting the page
+    CHECK(beginOptimisticRead(bm, h, 0, &v));
+    for (int i = 1; i < 4; i++) {
+        CHECK(pinPage(bm, w, i));
+        CHECK(unpinPage(bm, w));
+    }
+    rc = validateOptimisticRead(bm, h, v);
+    ASSERT_EQUALS_INT(RC_BM_OPTIMISTIC_READ_FALLBACK, rc, "eviction invalidates the read");
+    ASSERT_EQUALS_STRING("Page-0", h->data, "fallback re-read the page");
+    CHECK(unpinPage(bm, h));
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+
+    free(bm);
+    free(h);
+    free(w);
+    TEST_DONE();
+}
+
+void testMultipleFiles(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    char *expected = malloc(sizeof(char) * 512);
+    int other;
+    int i;
+    testName = "Testing a pool shared by two page files";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    CHECK(createPageFile("testbuffer2.bin"));
+    createDummyPages(bm, 10);
+
+    CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_LRU, NULL));
+    CHECK(registerPageFile(bm, "testbuffer2.bin", &other));
+    ASSERT_TRUE(other != BM_DEFAULT_FILE, "second file gets its own fileId");
+
+    // the same page number in both files lands in different frames
+    for (i = 0; i < 2; i++) {
+        CHECK(pinFilePage(bm, other, h, i));
+        sprintf(h->data, "%s-%i", "Other", h->pageNum);
+        CHECK(markFileDirty(bm, other, h));
+        CHECK(unpinFilePage(bm, other, h));
+
+        CHECK(pinPage(bm, h, i));
+        sprintf(expected, "%s-%i", "Page", i);
+        ASSERT_EQUALS_STRING(expected, h->data, "default file keeps its content");
+        CHECK(unpinPage(bm, h));
+    }
+    ASSERT_EQUALS_POOL("[0x0],[0 0],[1x0],[1 0]", bm, "both files share the frames");
+
+    // flushing one file leaves the other alone
+    CHECK(forceFlushFile(bm, other));
+    ASSERT_EQUALS_INT(2, getNumWriteIO(bm), "only the second file was written");
+
+    // a pinned page blocks invalidation
+    CHECK(pinFilePage(bm, other, h, 0));
+    ASSERT_ERROR(invalidateFile(bm, other), "can't invalidate a file with pinned pages");
+    CHECK(unpinFilePage(bm, other, h));
+
+    // invalidation drops the pages without writing them
+    CHECK(pinFilePage(bm, other, h, 1));
+    sprintf(h->data, "%s", "Dropped");
+    CHECK(markFileDirty(bm, other, h));
+    CHECK(unpinFilePage(bm, other, h));
+    CHECK(invalidateFile(bm, other));
+    ASSERT_EQUALS_POOL("[-1 0],[0 0],[-1 0],[1 0]", bm, "pages of the invalidated file are gone");
+    ASSERT_EQUALS_INT(2, getNumWriteIO(bm), "invalidation doesn't write");
+
+    CHECK(pinFilePage(bm, other, h, 1));
+    ASSERT_EQUALS_STRING("Other-1", h->data, "invalidated page is re-read from disk");
+    CHECK(unpinFilePage(bm, other, h));
+
+    CHECK(unregisterPageFile(bm, other));
+    ASSERT_ERROR(pinFilePage(bm, other, h, 0), "unregistered file can't be pinned");
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    CHECK(destroyPageFile("testbuffer2.bin"));
+
+    free(expected);
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void testResize(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_PageHandle *pinned = MAKE_PAGE_HANDLE();
+    BM_ReadVersion v;
+    BM_PoolCounts counts;
+    RC rc;
+    int i;
+    testName = "Testing resizing a running pool";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+
+    for (i = 0; i < 3; i++) {
+        CHECK(pinPage(bm, h, i));
+        CHECK(unpinPage(bm, h));
+    }
+
+    // growing keeps every page
+    CHECK(resizeBufferPool(bm, 5));
+    ASSERT_EQUALS_POOL("[0 0],[1 0],[2 0],[-1 0],[-1 0]", bm, "grown pool keeps its pages");
+    for (i = 3; i < 5; i++) {
+        CHECK(pinPage(bm, h, i));
+        CHECK(unpinPage(bm, h));
+    }
+    ASSERT_EQUALS_INT(5, getNumReadIO(bm), "new frames are used before anything is ejected");
+
+    // shrinking ejects in LRU order and packs the survivors, including the pinned page
+    CHECK(pinPage(bm, h, 1));
+    CHECK(markDirty(bm, h));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, pinned, 4));
+    CHECK(resizeBufferPool(bm, 2));
+    ASSERT_EQUALS_POOL("[4 1],[1x0]", bm, "shrunk pool keeps the hottest pages");
+    ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "clean pages are ejected without writing");
+    ASSERT_EQUALS_STRING("Page-4", pinned->data, "pinned page kept its buffer");
+    CHECK(getPoolCounts(bm, &counts));
+    ASSERT_EQUALS_INT(2 * PAGE_SIZE, (int) counts.bufferBytes, "buffers of the frames that went away are freed");
+
+    // the replacement order survives the resize
+    CHECK(pinPage(bm, h, 5));
+    CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_POOL("[4 1],[5 0]", bm, "LRU page ejected after resize");
+    ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "dirty page written when ejected");
+
+    ASSERT_ERROR(resizeBufferPool(bm, 0), "pool can't shrink to nothing");
+    CHECK(unpinPage(bm, pinned));
+
+    // an optimistic read of a page the shrink ejects still looks at live memory, and then fails validation
+    CHECK(beginOptimisticRead(bm, h, 4, &v));
+    CHECK(resizeBufferPool(bm, 1));
+    ASSERT_EQUALS_POOL("[5 0]", bm, "LRU page ejected by the shrink");
+    ASSERT_EQUALS_STRING("Page-4", h->data, "ejected page's buffer isn't freed");
+    CHECK(getPoolCounts(bm, &counts));
+    ASSERT_EQUALS_INT(2 * PAGE_SIZE, (int) counts.bufferBytes, "buffer kept as a spare while the read is open");
+    rc = validateOptimisticRead(bm, h, v);
+    ASSERT_EQUALS_INT(RC_BM_OPTIMISTIC_READ_FALLBACK, rc, "shrink invalidates the read");
+    CHECK(getPoolCounts(bm, &counts));
+    ASSERT_EQUALS_INT(PAGE_SIZE, (int) counts.bufferBytes, "spare freed once the read is validated");
+    CHECK(unpinPage(bm, h));
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+
+    free(bm);
+    free(h);
+    free(pinned);
+    TEST_DONE();
+}
+
+void testPrewarm(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    const int requests[] = {7, 2, 5, 7, 2};
+    int remaining;
+    int i;
+    testName = "Testing warm state dump and prewarm";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+    ASSERT_ERROR(prewarmBufferPool(bm, BM_DEFAULT_FILE, 1, &remaining), "no warm state yet");
+    CHECK(setWarmStateDump(bm, TRUE));
+    for (i = 0; i < 5; i++) {
+        CHECK(pinPage(bm, h, requests[i]));
+        CHECK(unpinPage(bm, h));
+    }
+    CHECK(shutdownBufferPool(bm));
+
+    // only the two hottest pages fit in the new pool, and they come back in page order
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+    CHECK(pinPage(bm, h, 0));
+    CHECK(unpinPage(bm, h));
+    CHECK(prewarmBufferPool(bm, BM_DEFAULT_FILE, 1, &remaining));
+    ASSERT_EQUALS_INT(1, remaining, "one page left after the first batch");
+    ASSERT_EQUALS_POOL("[0 0],[2 0],[-1 0]", bm, "first batch loaded");
+    CHECK(prewarmBufferPool(bm, BM_DEFAULT_FILE, 1, &remaining));
+    ASSERT_EQUALS_INT(0, remaining, "prewarm finished");
+    ASSERT_EQUALS_POOL("[0 0],[2 0],[7 0]", bm, "second batch loaded");
+
+    // the prewarmed pages keep their order from the dump and are newer than the page the client had pinned
+    CHECK(pinPage(bm, h, 9));
+    CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_POOL("[9 0],[2 0],[7 0]", bm, "the client's page goes first");
+    CHECK(pinPage(bm, h, 8));
+    CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_POOL("[9 0],[2 0],[8 0]", bm, "then the page that was dumped colder");
+
+    CHECK(pinPage(bm, h, 2));
+    ASSERT_EQUALS_STRING("Page-2", h->data, "prewarmed page has its content");
+    CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_INT(5, getNumReadIO(bm), "prewarmed page is a hit");
+    CHECK(pinPage(bm, h, 7));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 0));
+    CHECK(unpinPage(bm, h));
+
+    // hints rank before recency: the hot page is dumped first although it was used longest ago, the cold one last
+    CHECK(setWarmStateDump(bm, TRUE));
+    CHECK(pinPageWithHint(bm, h, 0, BM_HINT_HOT));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPageWithHint(bm, h, 2, BM_HINT_COLD));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 7));
+    CHECK(unpinPage(bm, h));
+    CHECK(shutdownBufferPool(bm));
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+    CHECK(pinPage(bm, h, 5));
+    CHECK(unpinPage(bm, h));
+    CHECK(prewarmBufferPool(bm, BM_DEFAULT_FILE, 3, &remaining));
+    ASSERT_EQUALS_POOL("[5 0],[0 0],[7 0]", bm, "hot and normal pages prewarmed, cold one left out");
+    CHECK(pinPage(bm, h, 9));
+    CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_POOL("[9 0],[0 0],[7 0]", bm, "the client's page goes first");
+    CHECK(pinPage(bm, h, 8));
+    CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_POOL("[9 0],[0 0],[8 0]", bm, "the hot page got its hint back");
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    CHECK(destroyPageFile("testbuffer.bin.warm"));
+
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void testPageSizes(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    SM_FileHandle fh;
+    BM_PageHandle small;
+    BM_ReadVersion v;
+    RC rc;
+    char *buf = malloc(16384);
+    char *content;
+    int large;
+    testName = "Testing page files with different page sizes";
+
+    ASSERT_ERROR(createPageFileWithSize("testbuffer2.bin", 6000), "page size must be a power of two");
+    ASSERT_ERROR(createPageFileWithSize("testbuffer2.bin", 2048), "page size must be at least 4K");
+    ASSERT_ERROR(createPageFileWithSize("testbuffer2.bin", 131072), "page size must be at most 64K");
+
+    CHECK(createPageFile("testbuffer.bin"));
+    CHECK(createPageFileWithSize("testbuffer2.bin", 16384));
+
+    CHECK(initBufferPool(bm, "testbuffer.bin", 2, RS_FIFO, NULL));
+    CHECK(registerPageFile(bm, "testbuffer2.bin", &large));
+    ASSERT_EQUALS_INT(PAGE_SIZE, getFilePageSize(bm, BM_DEFAULT_FILE), "default page size");
+    ASSERT_EQUALS_INT(16384, getFilePageSize(bm, large), "page size read from the header");
+
+    // the same frame holds a small and then a large page; an optimistic read of the small one keeps reading live
+    // memory when the frame's buffer is swapped for a larger one
+    CHECK(pinPage(bm, h, 0));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 1));
+    CHECK(unpinPage(bm, h));
+    CHECK(beginOptimisticRead(bm, &small, 0, &v));
+    CHECK(pinFilePage(bm, large, h, 3));
+    ASSERT_TRUE(small.data != h->data && small.data[0] == 0, "small page's buffer isn't freed");
+    rc = validateOptimisticRead(bm, &small, v);
+    ASSERT_EQUALS_INT(RC_BM_OPTIMISTIC_READ_FALLBACK, rc, "swapped buffer invalidates the read");
+    CHECK(unpinPage(bm, &small));
+    memset(h->data, 'x', 16384);
+    sprintf(h->data + 16000, "%s", "tail");
+    content = sprintPageContentWithSize(h, getFilePageSize(bm, large));
+    ASSERT_TRUE(strstr(content, "7461696C") != NULL, "the whole large page is printed");
+    free(content);
+
+    // optimistic reads of the second file, and their fallback pins are of its pages too
+    CHECK(beginOptimisticFileRead(bm, large, &small, 3, &v));
+    ASSERT_TRUE(small.data == h->data, "resident page of the second file read without a pin");
+    CHECK(markFileDirty(bm, large, h));
+    rc = validateOptimisticRead(bm, &small, v);
+    ASSERT_EQUALS_INT(RC_BM_OPTIMISTIC_READ_FALLBACK, rc, "write invalidates the read");
+    ASSERT_TRUE(small.data == h->data, "fallback pins the second file's page");
+    CHECK(unpinFilePage(bm, large, &small));
+    rc = beginOptimisticFileRead(bm, large, &small, 2, &v);
+    ASSERT_EQUALS_INT(RC_BM_OPTIMISTIC_READ_FALLBACK, rc, "page of the second file isn't resident");
+    CHECK(unpinFilePage(bm, large, &small)); // the pin was on the second file's page
+    CHECK(unpinFilePage(bm, large, h));
+    CHECK(shutdownBufferPool(bm));
+
+    CHECK(openPageFile("testbuffer2.bin", &fh));
+    ASSERT_EQUALS_INT(16384, fh.pageSize, "page size survives reopening");
+    ASSERT_EQUALS_INT(4, fh.totalNumPages, "file grew in large pages");
+    CHECK(readBlock(3, &fh, buf));
+    ASSERT_EQUALS_STRING("tail", buf + 16000, "whole large page was written");
+    CHECK(closePageFile(&fh));
+
+    // a header whose page size got corrupted is rejected rather than trusted
+    FILE *fp = fopen("testbuffer2.bin", "r+");
+    int badSize = 0;
+    fseek(fp, sizeof(int), SEEK_SET); // the page size follows the magic number
+    fwrite(&badSize, sizeof(int), 1, fp);
+    fclose(fp);
+    ASSERT_EQUALS_INT(RC_INVALID_PAGE_SIZE, openPageFile("testbuffer2.bin", &fh), "zero page size");
+
+    CHECK(destroyPageFile("testbuffer.bin"));
+    CHECK(destroyPageFile("testbuffer2.bin"));
+
+    free(buf);
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void testStatistics(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_PoolStatistics stats;
+    const int requests[] = {0, 1, 0, 2, 3, 0};
+    int i;
+    testName = "Testing pool statistics";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 2, RS_LRU, NULL));
+
+    for (i = 0; i < 6; i++) {
+        CHECK(pinPage(bm, h, requests[i]));
+        if (requests[i] == 1)
+            CHECK(markDirty(bm, h));
+        CHECK(unpinPage(bm, h));
+    }
+    CHECK(getPoolStatistics(bm, &stats));
+    ASSERT_EQUALS_INT(1, (int) stats.hits, "one pin found its page");
+    ASSERT_EQUALS_INT(5, (int) stats.misses, "five pins read their page");
+    ASSERT_EQUALS_INT(2, (int) stats.cleanEvictions, "clean evictions");
+    ASSERT_EQUALS_INT(1, (int) stats.dirtyEvictions, "dirty evictions");
+    ASSERT_EQUALS_INT(5, (int) stats.readIO.count, "every read is in the read histogram");
+    ASSERT_EQUALS_INT(1, (int) stats.writeIO.count, "every write is in the write histogram");
+    ASSERT_EQUALS_INT(5, (int) stats.pinMiss.count, "every miss is in the miss histogram");
+    printPoolStatistics(bm);
+
+    CHECK(resetPoolStatistics(bm));
+    CHECK(getPoolStatistics(bm, &stats));
+    ASSERT_EQUALS_INT(0, (int) (stats.hits + stats.misses + stats.readIO.count), "statistics start over");
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void testSnapshot(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_PoolSnapshot snap;
+    BM_PoolCounts counts;
+    PageNumber pageNums[4];
+    bool dirty[4];
+    int fixCounts[4];
+    testName = "Testing pool snapshots and aggregate counts";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_FIFO, NULL));
+
+    CHECK(getPoolCounts(bm, &counts));
+    ASSERT_EQUALS_INT(4, counts.numFree, "every frame starts free");
+
+    CHECK(pinPage(bm, h, 0));
+    CHECK(markDirty(bm, h));
+    CHECK(pinPage(bm, h, 1));
+    CHECK(pinPage(bm, h, 1));
+    CHECK(pinPage(bm, h, 2));
+    CHECK(unpinPage(bm, h));
+
+    snap.capacity = 4;
+    snap.pageNums = pageNums;
+    snap.fileIds = NULL;
+    snap.dirty = dirty;
+    snap.fixCounts = fixCounts;
+    CHECK(getPoolSnapshot(bm, &snap));
+    ASSERT_EQUALS_INT(4, snap.numPages, "every frame is in the snapshot");
+    ASSERT_EQUALS_INT(1, pageNums[1], "page numbers");
+    ASSERT_EQUALS_INT(NO_PAGE, pageNums[3], "empty frame");
+    ASSERT_TRUE(dirty[0] && !dirty[1], "dirty flags");
+    ASSERT_EQUALS_INT(2, fixCounts[1], "fix counts");
+
+    CHECK(getPoolCounts(bm, &counts));
+    ASSERT_EQUALS_INT(1, counts.numFree, "free frames");
+    ASSERT_EQUALS_INT(2, counts.numPinned, "pinned frames");
+    ASSERT_EQUALS_INT(1, counts.numDirty, "dirty frames");
+
+    h->pageNum = 0;
+    CHECK(unpinPage(bm, h));
+    h->pageNum = 1;
+    CHECK(unpinPage(bm, h));
+    CHECK(unpinPage(bm, h));
+    CHECK(forceFlushPool(bm));
+    CHECK(getPoolCounts(bm, &counts));
+    ASSERT_EQUALS_INT(0, counts.numPinned, "nothing pinned after unpinning");
+    ASSERT_EQUALS_INT(0, counts.numDirty, "nothing dirty after flushing");
+
+    snap.capacity = 3;
+    ASSERT_ERROR(getPoolSnapshot(bm, &snap), "snapshot arrays too small");
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+void testTrace(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_TraceRecord *records;
+    long long *refs;
+    int numRecords, numRefs, distances[5];
+    const int requests[] = {0, 1, 0, 2, 0};
+    const int expectedDistances[] = {0, 0, 2, 0, 2};
+    int i;
+    testName = "Testing access traces";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 2, RS_LRU, NULL));
+    CHECK(startTrace(bm, "testbuffer.trace", 100));
+    for (i = 0; i < 5; i++) {
+        CHECK(pinPage(bm, h, requests[i]));
+        if (i == 1)
+            CHECK(markDirty(bm, h));
+        CHECK(unpinPage(bm, h));
+    }
+    CHECK(stopTrace(bm));
+
+    CHECK(readTrace("testbuffer.trace", &records, &numRecords));
+    ASSERT_EQUALS_INT(11, numRecords, "five pins, five unpins and a markDirty");
+    ASSERT_EQUALS_INT(BM_TRACE_PIN, records[0].op, "trace starts with the first pin");
+    ASSERT_EQUALS_INT(BM_TRACE_DIRTY, records[3].op, "markDirty is traced");
+    ASSERT_EQUALS_INT(1, records[3].pageNum, "page of the markDirty");
+    ASSERT_TRUE(!(records[0].flags & BM_TRACE_HIT) && (records[5].flags & BM_TRACE_HIT), "hit flags");
+    ASSERT_TRUE(records[0].timestamp <= records[10].timestamp, "timestamps don't go back");
+
+    refs = tracePinReferences(records, numRecords, &numRefs);
+    ASSERT_EQUALS_INT(5, numRefs, "every pin is a reference");
+    lruStackDistances(refs, numRefs, distances);
+    for (i = 0; i < 5; i++)
+        ASSERT_EQUALS_INT(expectedDistances[i], distances[i], "LRU stack distance");
+    free(refs);
+    free(records);
+
+    // a ring of 4 events keeps only the latest 4
+    CHECK(startTrace(bm, "testbuffer.trace", 4));
+    for (i = 0; i < 5; i++) {
+        CHECK(pinPage(bm, h, requests[i]));
+        CHECK(unpinPage(bm, h));
+    }
+    CHECK(shutdownBufferPool(bm));
+    CHECK(readTrace("testbuffer.trace", &records, &numRecords));
+    ASSERT_EQUALS_INT(4, numRecords, "ring keeps its capacity");
+    ASSERT_EQUALS_INT(2, records[0].pageNum, "oldest surviving event");
+    ASSERT_EQUALS_INT(BM_TRACE_UNPIN, records[3].op, "newest event last");
+    free(records);
+
+    remove("testbuffer.trace");
+    CHECK(destroyPageFile("testbuffer.bin"));
+
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void testOptimal(void) {
+    const long long refs[] = {7, 0, 1, 2, 0, 3, 0, 4, 2, 3, 0, 3, 2, 1, 2, 0, 1, 7, 0, 1};
+    int distances[20], lruMisses = 0, i;
+    testName = "Testing the optimal replacement baseline";
+
+    // the textbook reference string: OPT misses 9 times with 3 frames, LRU 12 times
+    ASSERT_EQUALS_INT(9, (int) optimalMisses(refs, 20, 3), "OPT misses with 3 frames");
+    lruStackDistances(refs, 20, distances);
+    for (i = 0; i < 20; i++)
+        if (distances[i] == 0 || distances[i] > 3)
+            lruMisses++;
+    ASSERT_EQUALS_INT(12, lruMisses, "LRU misses with 3 frames");
+    ASSERT_EQUALS_INT(6, (int) optimalMisses(refs, 20, 6), "only cold misses once every page fits");
+    ASSERT_EQUALS_INT(20, (int) optimalMisses(refs, 20, 0), "no frames, no hits");
+
+    TEST_DONE();
+}
+
+// pins pages 0, 1, 2 once each, dirtying 0 and 2
+static void pinDirtyClean(BM_BufferPool *bm, BM_PageHandle *h) {
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        CHECK(pinPage(bm, h, i));
+        if (i != 1)
+            CHECK(markDirty(bm, h));
+        CHECK(unpinPage(bm, h));
+    }
+}
+
+void testCleanFirst(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    testName = "Testing clean-first eviction";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+    CHECK(setCleanFirstWindow(bm, 2));
+    pinDirtyClean(bm, h);
+    CHECK(pinPage(bm, h, 3));
+    CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_POOL("[0x0],[3 0],[2x0]", bm, "clean page 1 in the window is ejected before dirty page 0");
+    ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "the miss didn't write");
+    CHECK(pinPage(bm, h, 4));
+    CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_POOL("[4 0],[3 0],[2x0]", bm, "no clean page in the window: the coldest is ejected");
+    ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "the dirty page was written");
+    CHECK(shutdownBufferPool(bm));
+
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_CLOCK, NULL));
+    CHECK(setCleanFirstWindow(bm, 3));
+    pinDirtyClean(bm, h);
+    CHECK(pinPage(bm, h, 3));
+    CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_POOL("[0x0],[3 0],[2x0]", bm, "the hand passes over dirty pages");
+    ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "the miss didn't write");
+    CHECK(shutdownBufferPool(bm));
+
+    CHECK(destroyPageFile("testbuffer.bin"));
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void testGroupSync(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_PoolStatistics stats;
+    int i;
+    testName = "Testing group sync";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+    CHECK(setGroupSync(bm, 3, 1000000));
+
+    // five forced pages: the first three fill a group
+    for (i = 0; i < 5; i++) {
+        CHECK(pinPage(bm, h, i));
+        CHECK(markDirty(bm, h));
+        CHECK(forcePage(bm, h));
+        CHECK(unpinPage(bm, h));
+    }
+    CHECK(getPoolStatistics(bm, &stats));
+    ASSERT_EQUALS_INT(1, (int) stats.syncs, "three writes share a sync");
+    CHECK(syncBufferPool(bm));
+    CHECK(syncBufferPool(bm));
+    CHECK(getPoolStatistics(bm, &stats));
+    ASSERT_EQUALS_INT(2, (int) stats.syncs, "syncing syncs the rest, and only once");
+
+    for (i = 5; i < 7; i++) {
+        CHECK(pinPage(bm, h, i));
+        CHECK(markDirty(bm, h));
+        CHECK(unpinPage(bm, h));
+    }
+    CHECK(forceFlushPool(bm));
+    CHECK(getPoolStatistics(bm, &stats));
+    ASSERT_EQUALS_INT(3, (int) stats.syncs, "a flush of two pages ends with one sync");
+
+    // a group that stops growing is synced once it's older than the max delay
+    CHECK(setGroupSync(bm, 100, 1000));
+    CHECK(pinPage(bm, h, 7));
+    CHECK(markDirty(bm, h));
+    CHECK(forcePage(bm, h));
+    CHECK(unpinPage(bm, h));
+    usleep(2000);
+    CHECK(pollGroupSync(bm));
+    CHECK(getPoolStatistics(bm, &stats));
+    ASSERT_EQUALS_INT(4, (int) stats.syncs, "poll syncs a group past its delay");
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void testCheckpoint(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_PoolCounts counts;
+    int i, remaining;
+    testName = "Testing incremental checkpoints";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 10, RS_FIFO, NULL));
+
+    // dirty pages 0..5, keeping page 3 pinned
+    for (i = 0; i < 6; i++) {
+        CHECK(pinPage(bm, h, i));
+        CHECK(markDirty(bm, h));
+        if (i != 3)
+            CHECK(unpinPage(bm, h));
+    }
+    CHECK(getPoolCounts(bm, &counts));
+    ASSERT_TRUE(counts.oldestDirtyNanos > 0, "the dirty page table knows the oldest dirty page");
+
+    CHECK(beginCheckpoint(bm, 40));
+    CHECK(checkpointStep(bm, &remaining));
+    ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "the start of the interval writes a single page");
+    ASSERT_EQUALS_INT(5, remaining, "remaining checkpoint pages");
+    ASSERT_EQUALS_POOL("[0 0],[1x0],[2x0],[3x1],[4x0],[5x0],[-1 0],[-1 0],[-1 0],[-1 0]", bm,
+                       "oldest dirty page first");
+
+    // pages dirtied after the start belong to the next checkpoint
+    CHECK(pinPage(bm, h, 6));
+    CHECK(markDirty(bm, h));
+    CHECK(unpinPage(bm, h));
+    usleep(50000);
+    CHECK(checkpointStep(bm, &remaining));
+    ASSERT_EQUALS_INT(0, remaining, "checkpoint done");
+    ASSERT_EQUALS_POOL("[0 0],[1 0],[2 0],[3 1],[4 0],[5 0],[6x0],[-1 0],[-1 0],[-1 0]", bm,
+                       "only the page dirtied during the checkpoint is left, pinned pages were written too");
+    h->pageNum = 3;
+    CHECK(unpinPage(bm, h));
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void testFlushPinned(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    SM_FileHandle fh;
+    char *buf = malloc(PAGE_SIZE);
+    testName = "Testing flushes of pinned pages";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+
+    // a hot page stays pinned across the flush, and its holder keeps writing to it afterwards
+    CHECK(pinPage(bm, h, 1));
+    sprintf(h->data, "%s", "flushed");
+    CHECK(markDirty(bm, h));
+    CHECK(forceFlushPool(bm));
+    ASSERT_EQUALS_POOL("[1 1],[-1 0],[-1 0]", bm, "the pinned page was flushed and is clean");
+    ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "one write");
+    sprintf(h->data, "%s", "after");
+    CHECK(markDirty(bm, h));
+    ASSERT_EQUALS_POOL("[1x1],[-1 0],[-1 0]", bm, "writing it again makes it dirty again");
+
+    CHECK(openPageFile("testbuffer.bin", &fh));
+    CHECK(readBlock(1, &fh, buf));
+    ASSERT_EQUALS_STRING("flushed", buf, "the flush wrote the page as it was");
+    CHECK(closePageFile(&fh));
+
+    CHECK(unpinPage(bm, h));
+    CHECK(shutdownBufferPool(bm));
+    CHECK(openPageFile("testbuffer.bin", &fh));
+    CHECK(readBlock(1, &fh, buf));
+    ASSERT_EQUALS_STRING("after", buf, "the later write wasn't lost");
+    CHECK(closePageFile(&fh));
+
+    CHECK(destroyPageFile("testbuffer.bin"));
+    free(buf);
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void testCompressedTier(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_PoolStatistics stats;
+    char *page = calloc(PAGE_SIZE, 1);
+    char *packed = malloc(COMPRESS_BOUND(PAGE_SIZE));
+    char *back = malloc(PAGE_SIZE);
+    char expected[32];
+    int i, len;
+    unsigned int x = 1;
+    testName = "Testing the compressed victim tier";
+
+    // the codec: a mostly empty page shrinks a lot, random bytes don't shrink at all
+    sprintf(page, "%s", "Page-5, Page-5, Page-5");
+    len = compressPage(page, PAGE_SIZE, packed, COMPRESS_BOUND(PAGE_SIZE));
+    ASSERT_TRUE(len > 0 && len < 100, "an almost empty page compresses");
+    CHECK(decompressPage(packed, len, back, PAGE_SIZE));
+    ASSERT_TRUE(memcmp(page, back, PAGE_SIZE) == 0, "round trip");
+    ASSERT_ERROR(decompressPage(packed, len - 1, back, PAGE_SIZE), "truncated input is detected");
+    for (i = 0; i < PAGE_SIZE; i++) {
+        x = x * 1103515245 + 12345;
+        page[i] = (char) (x >> 16);
+    }
+    ASSERT_EQUALS_INT(-1, compressPage(page, PAGE_SIZE, packed, PAGE_SIZE - 1), "random bytes don't compress");
+    len = compressPage(page, PAGE_SIZE, packed, COMPRESS_BOUND(PAGE_SIZE));
+    CHECK(decompressPage(packed, len, back, PAGE_SIZE));
+    ASSERT_TRUE(memcmp(page, back, PAGE_SIZE) == 0, "round trip of random bytes");
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 2, RS_LRU, NULL));
+    CHECK(setCompressedTier(bm, 64 * 1024));
+
+    // 6 pages through 2 frames; the 4 ejected ones come back from the tier
+    for (i = 0; i < 6; i++) {
+        CHECK(pinPage(bm, h, i));
+        if (i == 1) {
+            sprintf(h->data, "%s", "changed");
+            CHECK(markDirty(bm, h));
+        }
+        CHECK(unpinPage(bm, h));
+    }
+    for (i = 0; i < 4; i++) {
+        CHECK(pinPage(bm, h, i));
+        sprintf(expected, "%s-%i", "Page", i);
+        ASSERT_EQUALS_STRING(i == 1 ? "changed" : expected, h->data, "page content from the tier");
+        CHECK(unpinPage(bm, h));
+    }
+    ASSERT_EQUALS_INT(6, getNumReadIO(bm), "no reads for pages in the tier");
+    ASSERT_EQUALS_INT(1, getNumWriteIO(bm), "the dirty page was written before it went into the tier");
+    CHECK(getPoolStatistics(bm, &stats));
+    ASSERT_EQUALS_INT(4, (int) stats.tierHits, "tier hits");
+
+    // pages 4 and 5 are in the tier now; invalidating the file drops them
+    CHECK(invalidateFile(bm, BM_DEFAULT_FILE));
+    CHECK(pinPage(bm, h, 4));
+    CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_INT(7, getNumReadIO(bm), "invalidated pages are read again");
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    free(page);
+    free(packed);
+    free(back);
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+static long fileSize(const char *fileName) {
+    FILE *fp = fopen(fileName, "r");
+    long size;
+
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+void testCompressedPageFile(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    SM_FileHandle fh, crashed;
+    char *page = malloc(PAGE_SIZE);
+    char *back = malloc(PAGE_SIZE);
+    long size = -1;
+    int i, reads;
+    unsigned int x = 7;
+    testName = "Testing compressed page files";
+
+    ASSERT_ERROR(createCompressedPageFile("testbuffer.bin", 6000), "page size must be a power of two");
+    CHECK(createCompressedPageFile("testbuffer.bin", PAGE_SIZE));
+
+    // through the buffer pool, which doesn't know the file is compressed
+    createDummyPages(bm, 100);
+    checkDummyPages(bm, 100);
+    ASSERT_TRUE(fileSize("testbuffer.bin") < 101 * PAGE_SIZE / 10, "100 pages take a fraction of their size on disk");
+
+    // random reads are one read each, the map stays in memory
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+    reads = getNumReadIO(bm);
+    for (i = 97; i > 0; i -= 13) {
+        BM_PageHandle h;
+        char expected[32];
+        CHECK(pinPage(bm, &h, i));
+        sprintf(expected, "%s-%i", "Page", i);
+        ASSERT_EQUALS_STRING(expected, h.data, "page read back");
+        CHECK(unpinPage(bm, &h));
+    }
+    ASSERT_EQUALS_INT(reads + 8, getNumReadIO(bm), "one read per page");
+    CHECK(shutdownBufferPool(bm));
+
+    // a page that no longer fits its slot moves, one that shrinks stays
+    CHECK(openPageFile("testbuffer.bin", &fh));
+    ASSERT_EQUALS_INT(100, fh.totalNumPages, "page count from the header");
+    for (i = 0; i < PAGE_SIZE; i++) {
+        x = x * 1103515245 + 12345;
+        page[i] = (char) (x >> 16);
+    }
+    CHECK(writeBlock(7, &fh, page));
+    memset(back, 0, PAGE_SIZE);
+    sprintf(back, "%s", "short");
+    CHECK(writeBlock(8, &fh, back));
+    CHECK(appendEmptyBlock(&fh));
+    CHECK(closePageFile(&fh));
+
+    CHECK(openPageFile("testbuffer.bin", &fh));
+    ASSERT_EQUALS_INT(101, fh.totalNumPages, "appended page counted");
+    CHECK(readBlock(7, &fh, back));
+    ASSERT_TRUE(memcmp(page, back, PAGE_SIZE) == 0, "incompressible page stored as is");
+    CHECK(readBlock(8, &fh, back));
+    ASSERT_EQUALS_STRING("short", back, "rewritten page");
+    CHECK(readBlock(9, &fh, back));
+    ASSERT_EQUALS_STRING("Page-9", back, "neighbour untouched");
+    CHECK(readBlock(100, &fh, back));
+    ASSERT_EQUALS_INT(0, back[0], "unwritten page reads as zeros");
+    ASSERT_ERROR(readBlock(101, &fh, back), "reading past the end");
+
+    // a page written after a sync doesn't touch the slot the map on disk has for it: a second handle, which reads
+    // that map like a process starting over after a crash would, still finds the synced page
+    memset(page, 0, PAGE_SIZE);
+    sprintf(page, "%s", "Synced");
+    CHECK(writeBlock(9, &fh, page));
+    CHECK(syncPageFile(&fh));
+    sprintf(page, "%s", "Unsynced");
+    CHECK(writeBlock(9, &fh, page));
+    CHECK(openPageFile("testbuffer.bin", &crashed));
+    CHECK(readBlock(9, &crashed, back));
+    ASSERT_EQUALS_STRING("Synced", back, "the map on disk still finds the synced page");
+    CHECK(closePageFile(&crashed));
+
+    // old maps and slots are reused once a newer map is durable, so syncing over and over doesn't grow the file, even
+    // with a page that keeps moving between an incompressible image and a small one
+    for (i = 0; i < PAGE_SIZE; i++) {
+        x = x * 1103515245 + 12345;
+        back[i] = (char) (x >> 16);
+    }
+    for (i = 0; i < 20; i++) {
+        sprintf(page, "%s-%i", "Rewritten", i);
+        CHECK(writeBlock(9, &fh, page));
+        CHECK(writeBlock(7, &fh, i % 2 ? page : back));
+        CHECK(syncPageFile(&fh));
+        if (i == 3)
+            size = fileSize("testbuffer.bin");
+    }
+    ASSERT_TRUE(size >= 0, "size taken during the rewrites");
+    ASSERT_TRUE(fileSize("testbuffer.bin") == size, "the file stops growing");
+    CHECK(closePageFile(&fh));
+
+    CHECK(openPageFile("testbuffer.bin", &fh));
+    CHECK(readBlock(9, &fh, back));
+    ASSERT_EQUALS_STRING("Rewritten-19", back, "last write read back");
+    CHECK(readBlock(10, &fh, back));
+    ASSERT_EQUALS_STRING("Page-10", back, "reused space left the other pages alone");
+    CHECK(closePageFile(&fh));
+
+    CHECK(destroyPageFile("testbuffer.bin"));
+    free(page);
+    free(back);
+    free(bm);
+    TEST_DONE();
+}
+
+void testPinnedCandidates(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    testName = "Testing that pinned frames are never eviction candidates";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    CHECK(initBufferPool(bm, "testbuffer.bin", 4, RS_LFU, NULL));
+
+    // pages 0 and 1 stay pinned; page 3 is the least used of the others
+    CHECK(pinPage(bm, h, 0));
+    CHECK(pinPage(bm, h, 1));
+    CHECK(pinPage(bm, h, 2));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 2));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 3));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 4));
+    ASSERT_EQUALS_POOL("[0 1],[1 1],[2 0],[4 1]", bm, "least used unpinned page ejected");
+
+    // once unpinned, page 0 is a candidate again, and ties go to the lowest frame
+    CHECK(unpinPage(bm, h));
+    h->pageNum = 0;
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 5));
+    ASSERT_EQUALS_POOL("[5 1],[1 1],[2 0],[4 0]", bm, "unpinned page is a candidate again");
+
+    // the candidates survive a resize
+    CHECK(resizeBufferPool(bm, 3));
+    ASSERT_EQUALS_POOL("[5 1],[1 1],[2 0]", bm, "resize ejects the coldest candidate");
+    CHECK(unpinPage(bm, h));
+    h->pageNum = 1;
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 6));
+    ASSERT_EQUALS_POOL("[6 1],[1 0],[2 0]", bm, "candidates rebuilt after the resize");
+    CHECK(unpinPage(bm, h));
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void testDiscardPage(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_PoolCounts counts;
+    int i;
+    testName = "Testing discarding pages into free frames";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+
+    for (i = 0; i < 3; i++) {
+        CHECK(pinPage(bm, h, i));
+        if (i == 1) {
+            sprintf(h->data, "%s", "temp");
+            CHECK(markDirty(bm, h));
+        }
+        CHECK(unpinPage(bm, h));
+    }
+
+    // the dirty page is dropped without a write, and its frame is free
+    h->pageNum = 1;
+    CHECK(discardPage(bm, h));
+    ASSERT_EQUALS_POOL("[0 0],[-1 0],[2 0]", bm, "discarded page is gone");
+    CHECK(getPoolCounts(bm, &counts));
+    ASSERT_EQUALS_INT(1, counts.numFree, "its frame is free");
+    ASSERT_EQUALS_INT(0, counts.numDirty, "and clean");
+    CHECK(invalidatePage(bm, BM_DEFAULT_FILE, 7));
+
+    // the next miss takes the free frame instead of ejecting page 0
+    CHECK(pinPage(bm, h, 5));
+    ASSERT_EQUALS_POOL("[0 0],[5 1],[2 0]", bm, "miss uses the free frame");
+    ASSERT_ERROR(discardPage(bm, h), "can't discard a pinned page");
+    CHECK(unpinPage(bm, h));
+
+    CHECK(pinPage(bm, h, 1));
+    ASSERT_EQUALS_STRING("Page-1", h->data, "the modification was never written");
+    CHECK(unpinPage(bm, h));
+    ASSERT_EQUALS_INT(0, getNumWriteIO(bm), "nothing was written");
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void testFrameScan(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    int other, i, reads;
+    char expected[32];
+    testName = "Testing page lookup by frame scan";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    CHECK(createPageFile("testbuffer2.bin"));
+    CHECK(initBufferPool(bm, "testbuffer.bin", 5, RS_FIFO, NULL));
+    CHECK(setLookupThreshold(bm, 16));
+    CHECK(registerPageFile(bm, "testbuffer2.bin", &other));
+
+    // both files have pages 1 and 2 in the pool; the scan has to tell them apart
+    for (i = 0; i < 3; i++) {
+        CHECK(pinPage(bm, h, i));
+        sprintf(h->data, "%s-%i", "Page", i);
+        CHECK(markDirty(bm, h));
+        CHECK(unpinPage(bm, h));
+    }
+    for (i = 1; i < 3; i++) {
+        CHECK(pinFilePage(bm, other, h, i));
+        sprintf(h->data, "%s-%i", "Other", i);
+        CHECK(markFileDirty(bm, other, h));
+        CHECK(unpinFilePage(bm, other, h));
+    }
+    reads = getNumReadIO(bm);
+    for (i = 1; i < 3; i++) {
+        CHECK(pinFilePage(bm, other, h, i));
+        sprintf(expected, "%s-%i", "Other", i);
+        ASSERT_EQUALS_STRING(expected, h->data, "page of the second file found");
+        CHECK(unpinFilePage(bm, other, h));
+        CHECK(pinPage(bm, h, i));
+        sprintf(expected, "%s-%i", "Page", i);
+        ASSERT_EQUALS_STRING(expected, h->data, "page of the first file found");
+        CHECK(unpinPage(bm, h));
+    }
+    ASSERT_EQUALS_INT(reads, getNumReadIO(bm), "all hits");
+    h->pageNum = NO_PAGE;
+    ASSERT_ERROR(unpinPage(bm, h), "free frames don't match NO_PAGE");
+
+    // a dropped page is gone from the scan, and the array follows a resize
+    h->pageNum = 1;
+    CHECK(discardPage(bm, h));
+    ASSERT_ERROR(unpinPage(bm, h), "discarded page isn't found");
+    CHECK(resizeBufferPool(bm, 12));
+    CHECK(pinFilePage(bm, other, h, 2));
+    ASSERT_EQUALS_STRING("Other-2", h->data, "found after the resize");
+    CHECK(unpinFilePage(bm, other, h));
+    ASSERT_EQUALS_INT(reads, getNumReadIO(bm), "still a hit");
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    CHECK(destroyPageFile("testbuffer2.bin"));
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void testFrameBitsets(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_PoolCounts counts;
+    int i, dirty, *fixCounts;
+    bool *dirtyFlags;
+    testName = "Testing pinned and dirty bitsets across words";
+
+    // 130 frames span three bit words; LRU_K also moves the access histories around
+    CHECK(createPageFile("testbuffer.bin"));
+    CHECK(initBufferPool(bm, "testbuffer.bin", 130, RS_LRU_K, (void *) 2L));
+    for (i = 0; i < 130; i++) {
+        CHECK(pinPage(bm, h, i));
+        if (i % 5 == 0)
+            CHECK(markDirty(bm, h));
+        if (i % 3 != 0)
+            CHECK(unpinPage(bm, h));
+    }
+    CHECK(getPoolCounts(bm, &counts));
+    ASSERT_EQUALS_INT(0, counts.numFree, "pool is full");
+    ASSERT_EQUALS_INT(44, counts.numPinned, "every third page is pinned");
+    ASSERT_EQUALS_INT(26, counts.numDirty, "every fifth page is dirty");
+
+    // too many pins to shrink that far, then a shrink that packs the pinned pages into the low frames
+    ASSERT_EQUALS_INT(RC_BM_PAGE_PINNED, resizeBufferPool(bm, 40), "44 pinned pages don't fit in 40 frames");
+    CHECK(resizeBufferPool(bm, 60));
+    CHECK(getPoolCounts(bm, &counts));
+    ASSERT_EQUALS_INT(44, counts.numPinned, "pins survive the resize");
+    fixCounts = getFixCounts(bm);
+    dirtyFlags = getDirtyFlags(bm);
+    for (i = 0, dirty = 0; i < 60; i++)
+        dirty += dirtyFlags[i];
+    ASSERT_EQUALS_INT(dirty, counts.numDirty, "dirty count matches the flags");
+    for (i = 0, dirty = 0; i < 60; i++)
+        dirty += fixCounts[i];
+    ASSERT_EQUALS_INT(44, dirty, "fix counts match the pins");
+    free(fixCounts);
+    free(dirtyFlags);
+
+    for (i = 0; i < 130; i += 3) {
+        h->pageNum = i;
+        CHECK(unpinPage(bm, h));
+    }
+    CHECK(getPoolCounts(bm, &counts));
+    ASSERT_EQUALS_INT(0, counts.numPinned, "nothing pinned");
+    CHECK(forceFlushPool(bm));
+    CHECK(getPoolCounts(bm, &counts));
+    ASSERT_EQUALS_INT(0, counts.numDirty, "nothing dirty after the flush");
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+// a custom strategy for testCustomStrategy: ejects the unpinned page with the highest page number
+typedef struct HighestFirst {
+    PageNumber pages[4];  // per frame, NO_PAGE if free
+    int loads, hits, unpins, evicts, moves;
+    int grants;           // victims it hands out before it refuses, -1 for no limit
+} HighestFirst;
+
+static void highestLoad(void *state, int frame, int fileId, PageNumber pageNum) {
+    HighestFirst *s = state;
+    s->pages[frame] = pageNum;
+    s->loads++;
+}
+
+static void highestHit(void *state, int frame) {
+    ((HighestFirst *) state)->hits++;
+}
+
+static void highestUnpin(void *state, int frame, int fixCount) {
+    ((HighestFirst *) state)->unpins++;
+}
+
+static int highestVictim(void *state, const int *fixCounts, int numFrames) {
+    HighestFirst *s = state;
+    int victim = -1;
+
+    if (s->grants == 0)
+        return -1;
+    if (s->grants > 0)
+        s->grants--;
+    for (int i = 0; i < numFrames; i++)
+        if (s->pages[i] != NO_PAGE && fixCounts[i] == 0 && (victim < 0 || s->pages[i] > s->pages[victim]))
+            victim = i;
+    return victim;
+}
+
+static void highestEvict(void *state, int frame) {
+    HighestFirst *s = state;
+    s->pages[frame] = NO_PAGE;
+    s->evicts++;
+}
+
+static void highestMove(void *state, int from, int to) {
+    HighestFirst *s = state;
+    s->pages[to] = s->pages[from];
+    s->pages[from] = NO_PAGE;
+    s->moves++;
+}
+
+void testCustomStrategy(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    HighestFirst state = {{NO_PAGE, NO_PAGE, NO_PAGE, NO_PAGE}, 0, 0, 0, 0, 0, -1};
+    BM_CustomStrategy custom = {.state = &state, .onLoad = highestLoad, .onHit = highestHit, .onUnpin = highestUnpin,
+                                .chooseVictim = highestVictim, .onEvict = highestEvict, .onMove = highestMove};
+    int i;
+    testName = "Testing a custom replacement strategy";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    ASSERT_ERROR(initBufferPool(bm, "testbuffer.bin", 3, RS_CUSTOM, NULL), "RS_CUSTOM needs its callbacks");
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_CUSTOM, &custom));
+
+    for (i = 0; i < 3; i++) {
+        CHECK(pinPage(bm, h, i));
+        CHECK(unpinPage(bm, h));
+    }
+    CHECK(pinPage(bm, h, 1));
+    ASSERT_EQUALS_INT(3, state.loads, "three pages loaded");
+    ASSERT_EQUALS_INT(1, state.hits, "one hit");
+    ASSERT_EQUALS_INT(3, state.unpins, "three unpins");
+
+    // page 1 is pinned, so the strategy gets page 2 and then page 3
+    CHECK(pinPage(bm, h, 3));
+    ASSERT_EQUALS_POOL("[0 0],[1 1],[3 1]", bm, "highest unpinned page ejected");
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 4));
+    ASSERT_EQUALS_POOL("[0 0],[1 1],[4 1]", bm, "highest unpinned page ejected again");
+    ASSERT_EQUALS_INT(2, state.evicts, "the strategy saw both evictions");
+
+    // shrinking ejects the only unpinned page and moves page 4 into frame 0
+    CHECK(resizeBufferPool(bm, 2));
+    ASSERT_EQUALS_POOL("[4 1],[1 1]", bm, "pinned pages packed");
+    ASSERT_EQUALS_INT(1, state.moves, "the strategy saw the move");
+    ASSERT_EQUALS_INT(4, state.pages[0], "and followed it");
+    ASSERT_ERROR(pinPage(bm, h, 5), "no unpinned page to eject");
+
+    CHECK(unpinPage(bm, h));
+    h->pageNum = 1;
+    CHECK(unpinPage(bm, h));
+
+    // a strategy that runs out of victims halfway through a shrink doesn't stop it: the lowest frames go instead
+    CHECK(resizeBufferPool(bm, 4));
+    for (i = 5; i < 7; i++) {
+        CHECK(pinPage(bm, h, i));
+        CHECK(unpinPage(bm, h));
+    }
+    state.grants = 1;
+    CHECK(resizeBufferPool(bm, 1));
+    ASSERT_EQUALS_POOL("[5 0]", bm, "strategy's victim, then the lowest frames ejected");
+    ASSERT_EQUALS_INT(6, state.evicts, "the strategy saw every eviction");
+    ASSERT_EQUALS_INT(5, state.pages[0], "and the move");
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+void testPageHints(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    testName = "Testing page hints";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+    ASSERT_ERROR(setResidentShare(bm, 101), "share is a percentage");
+    ASSERT_ERROR(pinPageWithHint(bm, h, 0, BM_HINT_RESIDENT + 1), "unknown hint");
+    CHECK(setResidentShare(bm, 34)); // one frame
+
+    // page 0 is resident, page 1 asks to be too but the share is used up, so it's hot
+    CHECK(pinPageWithHint(bm, h, 0, BM_HINT_RESIDENT));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPageWithHint(bm, h, 1, BM_HINT_RESIDENT));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 2));
+    CHECK(unpinPage(bm, h));
+
+    // the normal page goes first although it's the most recently used, then the cold one
+    CHECK(pinPageWithHint(bm, h, 3, BM_HINT_COLD));
+    ASSERT_EQUALS_POOL("[0 0],[1 0],[3 1]", bm, "normal page ejected before hot and resident ones");
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 4));
+    ASSERT_EQUALS_POOL("[0 0],[1 0],[4 1]", bm, "cold page ejected");
+
+    // pinPage keeps a page's hint, so re-pinning page 1 leaves it hot
+    CHECK(pinPage(bm, h, 1));
+    CHECK(unpinPage(bm, h));
+    h->pageNum = 4;
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 5));
+    ASSERT_EQUALS_POOL("[0 0],[1 0],[5 1]", bm, "hot page kept over a normal one");
+
+    // with only hot and resident pages left, the hot one goes, then the resident one: the class is soft
+    CHECK(pinPage(bm, h, 6));
+    ASSERT_EQUALS_POOL("[0 0],[6 1],[5 1]", bm, "hot page ejected before the resident one");
+    CHECK(pinPage(bm, h, 7));
+    ASSERT_EQUALS_POOL("[7 1],[6 1],[5 1]", bm, "resident page ejected when nothing else can go");
+    for (h->pageNum = 5; h->pageNum <= 7; h->pageNum++)
+        CHECK(unpinPage(bm, h));
+    CHECK(shutdownBufferPool(bm));
+
+    // CLOCK passes over the resident page, and a cold page goes on the hand's first visit
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_CLOCK, NULL));
+    CHECK(setResidentShare(bm, 34));
+    CHECK(pinPageWithHint(bm, h, 0, BM_HINT_RESIDENT));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 1));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPageWithHint(bm, h, 2, BM_HINT_COLD));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 3));
+    ASSERT_EQUALS_POOL("[0 0],[1 0],[3 1]", bm, "cold page ejected first");
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 4));
+    ASSERT_EQUALS_POOL("[0 0],[1 0],[4 1]", bm, "resident page passed over");
+    CHECK(unpinPage(bm, h));
+
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+// what testAsyncPin's callbacks saw
+typedef struct AsyncPins {
+    int calls;
+    int failed;
+    PageNumber pages[8];  // the pages pinned, in callback order
+    char data[8][16];     // the start of each page's data
+} AsyncPins;
+
+static void recordPin(BM_BufferPool *const bm, BM_PageHandle *const page, RC rc, void *ctx) {
+    AsyncPins *pins = ctx;
+
+    if (rc != RC_OK) {
+        pins->failed++;
+        return;
+    }
+    pins->pages[pins->calls] = page->pageNum;
+    strncpy(pins->data[pins->calls], page->data, 15);
+    pins->data[pins->calls][15] = '\0';
+    pins->calls++;
+}
+
+void testAsyncPin(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    AsyncPins pins;
+    char expected[16];
+    RC rc;
+    testName = "Testing asynchronous pins";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_LRU, NULL));
+    memset(&pins, 0, sizeof(pins));
+
+    // a hit calls back right away
+    CHECK(pinPage(bm, h, 0));
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPageAsync(bm, 0, recordPin, &pins));
+    ASSERT_EQUALS_INT(1, pins.calls, "hit called back inline");
+    CHECK(unpinPage(bm, h));
+
+    // two misses, the second page pinned twice: both pins share one read
+    rc = pinPageAsync(bm, 1, recordPin, &pins);
+    ASSERT_EQUALS_INT(RC_BM_PIN_PENDING, rc, "miss is pending");
+    rc = pinPageAsync(bm, 2, recordPin, &pins);
+    ASSERT_EQUALS_INT(RC_BM_PIN_PENDING, rc, "second miss is pending");
+    rc = pinPageAsync(bm, 2, recordPin, &pins);
+    ASSERT_EQUALS_INT(RC_BM_PIN_PENDING, rc, "pin joins the read that's out");
+    ASSERT_EQUALS_INT(3, getNumReadIO(bm), "one read per page");
+    ASSERT_TRUE(getAsyncPinFd(bm) >= 0, "event descriptor");
+    h->pageNum = 1;
+    ASSERT_ERROR(unpinPage(bm, h), "page isn't the client's before its callback");
+    while (pins.calls < 4)
+        pollAsyncPins(bm, TRUE);
+    ASSERT_EQUALS_POOL("[0 0],[1 1],[2 2]", bm, "pages pinned once per callback");
+    for (int i = 1; i < 4; i++) {
+        sprintf(expected, "Page-%i", pins.pages[i]);
+        ASSERT_EQUALS_STRING(expected, pins.data[i], "page read in the background");
+    }
+    ASSERT_EQUALS_INT(0, pollAsyncPins(bm, TRUE), "nothing left to complete");
+
+    // page 0 is the only one that can go; then nothing can
+    rc = pinPageAsync(bm, 3, recordPin, &pins);
+    ASSERT_EQUALS_INT(RC_BM_PIN_PENDING, rc, "miss ejects page 0");
+    ASSERT_ERROR(pinPageAsync(bm, 4, recordPin, &pins), "no unpinned page to eject");
+
+    // pinPage waits for the read that's out
+    CHECK(pinPage(bm, h, 3));
+    ASSERT_EQUALS_INT(5, pins.calls, "the read completed while pinPage waited");
+    ASSERT_EQUALS_INT(4, getNumReadIO(bm), "pinPage didn't read the page again");
+    ASSERT_EQUALS_POOL("[3 2],[1 1],[2 2]", bm, "both pins of page 3");
+    ASSERT_EQUALS_INT(0, pins.failed, "no pin failed");
+
+    for (int i = 1; i < pins.calls; i++) {
+        h->pageNum = pins.pages[i];
+        CHECK(unpinPage(bm, h));
+    }
+    h->pageNum = 3;
+    CHECK(unpinPage(bm, h));
+
+    // shutting down completes the reads that are out first
+    rc = pinPageAsync(bm, 5, recordPin, &pins);
+    ASSERT_EQUALS_INT(RC_BM_PIN_PENDING, rc, "miss before shutdown");
+    ASSERT_ERROR(shutdownBufferPool(bm), "the pin completed, and is still held");
+    ASSERT_EQUALS_INT(6, pins.calls, "callback ran during shutdown");
+    h->pageNum = 5;
+    CHECK(unpinPage(bm, h));
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    free(bm);
+    free(h);
+    TEST_DONE();
+}
+
+// the child process of testSharedPool; its exit status says which check failed
+static int sharedPoolChild(const char *shmName) {
+    BM_SharedPool *pool;
+    BM_PageHandle h1, h2;
+
+    if (attachSharedPool(&pool, shmName, "testbuffer.bin", 3) != RC_OK)
+        return 1;
+    if (pinSharedPage(pool, &h1, 1) != RC_OK || strcmp(h1.data, "Shared-1") != 0)
+        return 2; // the parent's change, never written to the file
+    if (pinSharedPage(pool, &h2, 2) != RC_OK || strcmp(h2.data, "Page-2") != 0)
+        return 3;
+    if (unpinSharedPage(pool, &h1) != RC_OK || unpinSharedPage(pool, &h2) != RC_OK)
+        return 4;
+    return detachSharedPool(pool) == RC_OK ? 0 : 5;
+}
+
+// dirties a page and dies holding it, without detaching
+static int sharedPoolDyingChild(const char *shmName) {
+    BM_SharedPool *pool;
+    BM_PageHandle h;
+
+    if (attachSharedPool(&pool, shmName, "testbuffer.bin", 4) != RC_OK || pinSharedPage(pool, &h, 5) != RC_OK)
+        return 1;
+    sprintf(h.data, "%s", "Shared-5");
+    return markSharedDirty(pool, &h) == RC_OK ? 0 : 2;
+}
+
+void testSharedPool(void) {
+    BM_BufferPool *bm = MAKE_POOL();
+    BM_PageHandle *h = MAKE_PAGE_HANDLE();
+    BM_SharedPool *pool, *other;
+    BM_PoolCounts counts;
+    char shmName[64];
+    int status;
+    pid_t child;
+    testName = "Testing a pool shared between processes";
+
+    CHECK(createPageFile("testbuffer.bin"));
+    createDummyPages(bm, 10);
+    sprintf(shmName, "/test_assign_%d", (int) getpid());
+    CHECK(attachSharedPool(&pool, shmName, "testbuffer.bin", 3));
+    ASSERT_ERROR(attachSharedPool(&other, shmName, "testbuffer.bin", 4), "pool exists with another size");
+
+    CHECK(pinSharedPage(pool, h, 1));
+    ASSERT_EQUALS_STRING("Page-1", h->data, "page read into the segment");
+    sprintf(h->data, "%s", "Shared-1");
+    CHECK(markSharedDirty(pool, h));
+    CHECK(unpinSharedPage(pool, h));
+
+    // the child sees the dirty page, and its miss lands in the segment
+    fflush(stdout);
+    child = fork();
+    if (child == 0)
+        _exit(sharedPoolChild(shmName));
+    ASSERT_TRUE(waitpid(child, &status, 0) == child && WIFEXITED(status), "child ran");
+    ASSERT_EQUALS_INT(0, WEXITSTATUS(status), "child found both pages");
+    ASSERT_EQUALS_INT(2, getSharedNumReadIO(pool), "child read only page 2");
+    ASSERT_EQUALS_INT(0, getSharedNumWriteIO(pool), "dirty page shared without a write");
+
+    CHECK(pinSharedPage(pool, h, 2));
+    ASSERT_EQUALS_STRING("Page-2", h->data, "child's page");
+    ASSERT_EQUALS_INT(2, getSharedNumReadIO(pool), "pin of the child's page is a hit");
+    CHECK(getSharedPoolCounts(pool, &counts));
+    ASSERT_EQUALS_INT(1, counts.numFree, "one frame free");
+    ASSERT_EQUALS_INT(1, counts.numPinned, "one page pinned");
+    ASSERT_EQUALS_INT(1, counts.numDirty, "one page dirty");
+    ASSERT_ERROR(detachSharedPool(pool), "pins held");
+    CHECK(unpinSharedPage(pool, h));
+
+    // CLOCK ejects page 1, writing it back first
+    CHECK(pinSharedPage(pool, h, 3));
+    CHECK(unpinSharedPage(pool, h));
+    CHECK(pinSharedPage(pool, h, 4));
+    ASSERT_EQUALS_INT(1, getSharedNumWriteIO(pool), "dirty victim written back");
+    sprintf(h->data, "%s", "Shared-4");
+    CHECK(markSharedDirty(pool, h));
+    CHECK(unpinSharedPage(pool, h));
+
+    // the last process out flushes and removes the segment
+    CHECK(detachSharedPool(pool));
+    CHECK(attachSharedPool(&pool, shmName, "testbuffer.bin", 4));
+    ASSERT_EQUALS_INT(0, getSharedNumReadIO(pool), "a new segment");
+
+    // a process that dies attached doesn't keep the detach below from being the last one
+    fflush(stdout);
+    child = fork();
+    if (child == 0)
+        _exit(sharedPoolDyingChild(shmName));
+    ASSERT_TRUE(waitpid(child, &status, 0) == child && WIFEXITED(status), "dying child ran");
+    ASSERT_EQUALS_INT(0, WEXITSTATUS(status), "dying child dirtied its page");
+    CHECK(detachSharedPool(pool));
+    CHECK(attachSharedPool(&pool, shmName, "testbuffer.bin", 4));
+    ASSERT_EQUALS_INT(0, getSharedNumReadIO(pool), "the segment was removed");
+    CHECK(detachSharedPool(pool));
+
+    CHECK(initBufferPool(bm, "testbuffer.bin", 3, RS_FIFO, NULL));
+    CHECK(pinPage(bm, h, 1));
+    ASSERT_EQUALS_STRING("Shared-1", h->data, "page written back on ejection");
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 4));
+    ASSERT_EQUALS_STRING("Shared-4", h->data, "page written back on the last detach");
+    CHECK(unpinPage(bm, h));
+    CHECK(pinPage(bm, h, 5));
+    ASSERT_EQUALS_STRING("Shared-5", h->data, "dead process's page written back on the last detach");
+    CHECK(unpinPage(bm, h));
+    CHECK(shutdownBufferPool(bm));
+    CHECK(destroyPageFile("testbuffer.bin"));
+    free(bm);
+    free(h);
+    TEST_DONE();
+}